@@ -0,0 +1,733 @@
+// Benchmarks for the per-report input path. Results go to stdout as one JSON object, so runs can be
+// diffed or checked against a baseline by a script.
+//
+//   lowlatencydancegamesdk_bench [--seconds N] [--hardware | --audit]
+//
+// --hardware (Linux only) skips the simulated runs and instead streams from the real pads plugged in, once
+// through libusb and once through usbfs, so the two event paths can be compared on the same hardware.
+//
+// --audit needs a build with -DLLDGSDK_AUDIT=ON. It streams from simulated pads and exits with status 1 if
+// the input path allocated, locked or made a syscall after warming up, so it can gate changes in CI.
+
+#include "lowlatencydancegamesdk.h"
+#include "lowlatencydancegamesdk_recording.h"
+#include "MonotonicClock.h"
+#include "HotPathAudit.h"
+#include "PressHistory.h"
+#include "SeqlockLatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+extern "C" {
+    #include "adapters/AdapterBase.h"
+    #include "adapters/AdapterLayout.h"
+    #include "adapters/SMXStage/SMXStageAdapter.h"
+    #include "adapters/FoamPad/FoamPadAdapter.h"
+}
+
+using SDK = LowLatencyDanceGameSDK;
+
+static volatile uint32_t g_sink;
+
+struct JsonWriter {
+    bool first = true;
+
+    void begin() { printf("{\n  \"benchmarks\": [\n"); }
+    void end() { printf("\n  ]\n}\n"); }
+
+    void open(const char* name) {
+        printf("%s    {\"name\": \"%s\"", first ? "" : ",\n", name);
+        first = false;
+    }
+    void field(const char* key, uint64_t value) { printf(", \"%s\": %llu", key, static_cast<unsigned long long>(value)); }
+    void field(const char* key, double value) { printf(", \"%s\": %.3f", key, value); }
+    void close() { printf("}"); }
+};
+
+// Per-operation cost of `body`, run `iterations` times, where each run does `ops_per_iteration` operations
+template <typename Body>
+static void benchOps(JsonWriter& out, const char* name, uint64_t iterations, Body body, uint64_t ops_per_iteration = 1) {
+    for (uint64_t i = 0; i < iterations / 10; i++) {
+        body(i);
+    }
+    uint64_t start = monotonicNanoseconds();
+    for (uint64_t i = 0; i < iterations; i++) {
+        body(i);
+    }
+    uint64_t elapsed = monotonicNanoseconds() - start;
+
+    uint64_t ops = iterations * ops_per_iteration;
+    out.open(name);
+    out.field("iterations", ops);
+    out.field("ns_per_op", static_cast<double>(elapsed) / ops);
+    out.field("ops_per_sec", ops * 1e9 / (elapsed ? elapsed : 1));
+    out.close();
+}
+
+static void writeLatencies(JsonWriter& out, const char* name, std::vector<uint64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double fraction) -> uint64_t {
+        if (samples.empty()) return 0;
+        size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+        return samples[index];
+    };
+
+    out.open(name);
+    out.field("samples", static_cast<uint64_t>(samples.size()));
+    out.field("p50_ns", at(0.5));
+    out.field("p99_ns", at(0.99));
+    out.field("p999_ns", at(0.999));
+    out.field("max_ns", samples.empty() ? 0 : samples.back());
+}
+
+static void benchConverters(JsonWriter& out) {
+    // A spread of reports so the converters can't just predict one input
+    const int report_count = 256;
+    uint8_t reports[report_count][8];
+    uint32_t x = 12345;
+    for (int i = 0; i < report_count; i++) {
+        for (int j = 0; j < 8; j++) {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            reports[i][j] = static_cast<uint8_t>(x);
+        }
+    }
+
+    struct DancePadAdapter smx = default_smx_adapter();
+    struct DancePadAdapter foam = default_foam_pad_adapter();
+
+    benchOps(out, "smx_input_converter", 50000000, [&](uint64_t i) {
+        g_sink += smx.input_converter(reports[i & (report_count - 1)], 3);
+    });
+    benchOps(out, "foam_input_converter", 50000000, [&](uint64_t i) {
+        g_sink += foam.input_converter(reports[i & (report_count - 1)], 8);
+    });
+    benchOps(out, "smx_classify_report", 50000000, [&](uint64_t i) {
+        const uint8_t* payload = nullptr;
+        int payload_length = 0;
+        reports[i & (report_count - 1)][0] = 3;
+        g_sink += smx.classify_report(reports[i & (report_count - 1)], 3, &payload, &payload_length);
+    });
+
+    // Batches are reported per report, so they compare directly with the single-report numbers above
+    int lengths[report_count];
+    uint16_t states[report_count];
+    for (int i = 0; i < report_count; i++) {
+        lengths[i] = 8;
+    }
+    benchOps(out, "smx_input_converter_batch", 50000000 / report_count, [&](uint64_t) {
+        dance_pad_adapter_convert_batch(&smx, &reports[0][0], 8, lengths, report_count, states);
+        g_sink += states[report_count - 1];
+    }, report_count);
+    benchOps(out, "foam_input_converter_batch", 50000000 / report_count, [&](uint64_t) {
+        dance_pad_adapter_convert_batch(&foam, &reports[0][0], 8, lengths, report_count, states);
+        g_sink += states[report_count - 1];
+    }, report_count);
+}
+
+static void benchAdapterLookup(JsonWriter& out) {
+    struct DancePadAdapter smx = default_smx_adapter();
+    struct DancePadAdapter foam = default_foam_pad_adapter();
+
+    benchOps(out, "dance_pad_adapter_for_smx", 20000000, [&](uint64_t) {
+        g_sink += dance_pad_adapter_for(smx.vendor_id, smx.product_id).is_valid;
+    });
+    benchOps(out, "dance_pad_adapter_for_foam", 20000000, [&](uint64_t) {
+        g_sink += dance_pad_adapter_for(foam.vendor_id, foam.product_id).is_valid;
+    });
+    benchOps(out, "dance_pad_adapter_for_miss", 20000000, [&](uint64_t) {
+        g_sink += dance_pad_adapter_for(0x1234, 0x5678).is_valid;
+    });
+
+    // Lookups should cost the same once the registry holds hundreds of pads
+    for (uint16_t i = 0; i < 500; i++) {
+        struct DancePadAdapter extra = foam;
+        extra.vendor_id = 0x1000 + (i >> 4);
+        extra.product_id = i;
+        dance_pad_adapter_register(&extra);
+    }
+    benchOps(out, "dance_pad_adapter_for_smx_500_registered", 20000000, [&](uint64_t) {
+        g_sink += dance_pad_adapter_for(smx.vendor_id, smx.product_id).is_valid;
+    });
+    benchOps(out, "dance_pad_adapter_for_miss_500_registered", 20000000, [&](uint64_t) {
+        g_sink += dance_pad_adapter_for(0x1234, 0x5678).is_valid;
+    });
+}
+
+// The same publish/read pattern DeviceState uses for last_button_state, with and without the other side running
+static void benchAtomicState(JsonWriter& out) {
+    struct alignas(64) SharedState {
+        std::atomic<uint16_t> value{0};
+    };
+    SharedState state;
+
+    benchOps(out, "state_publish_uncontended", 100000000, [&](uint64_t i) {
+        state.value = static_cast<uint16_t>(i);
+    });
+    benchOps(out, "state_read_uncontended", 100000000, [&](uint64_t) {
+        g_sink += state.value;
+    });
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        uint16_t i = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            state.value = i++;
+        }
+    });
+    benchOps(out, "state_read_while_publishing", 100000000, [&](uint64_t) {
+        g_sink += state.value;
+    });
+    stop = true;
+    writer.join();
+}
+
+// snapshot(): a whole table of player states copied under the seqlock latch, with and without a writer
+// publishing one player's change after another as fast as it can
+static void benchSnapshot(JsonWriter& out) {
+    using Latch = SeqlockLatch<SDK::PlayerSnapshot, SDK::MAX_DEVICES>;
+    std::unique_ptr<Latch> latch(new Latch());
+    SDK::PlayerSnapshot players[SDK::MAX_DEVICES];
+
+    benchOps(out, "snapshot_publish_uncontended", 10000000, [&](uint64_t i) {
+        SDK::PlayerSnapshot entry = { static_cast<uint16_t>(i), true, i, i };
+        latch->publish(i & 1, entry);
+    });
+    benchOps(out, "snapshot_read_uncontended", 2000000, [&](uint64_t) {
+        g_sink += static_cast<uint32_t>(latch->read(players));
+    });
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); i++) {
+            SDK::PlayerSnapshot entry = { static_cast<uint16_t>(i), true, i, i };
+            latch->publish(i & 1, entry);
+        }
+    });
+    benchOps(out, "snapshot_read_while_publishing", 2000000, [&](uint64_t) {
+        g_sink += static_cast<uint32_t>(latch->read(players));
+    });
+    stop = true;
+    writer.join();
+}
+
+// Press history queries the way judgment code makes them, alone and while a writer records a press or
+// release of every panel as fast as it can, far more often than any pad changes
+static void benchPressHistory(JsonWriter& out) {
+    using History = PressHistory<SDK::PRESS_HISTORY_LENGTH>;
+    std::unique_ptr<History> history(new History());
+    uint16_t state = 0;
+    for (int i = 0; i < 64; i++) {
+        history->record(state, static_cast<uint16_t>(~state), static_cast<uint64_t>(i) * 1000);
+        state = static_cast<uint16_t>(~state);
+    }
+
+    History::Press presses[SDK::PRESS_HISTORY_LENGTH];
+    benchOps(out, "press_history_last_uncontended", 20000000, [&](uint64_t i) {
+        g_sink += static_cast<uint32_t>(history->copy(static_cast<int>(i & 15), presses, 1));
+    });
+    benchOps(out, "press_history_all_uncontended", 2000000, [&](uint64_t i) {
+        g_sink += static_cast<uint32_t>(history->copy(static_cast<int>(i & 15), presses));
+    });
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        uint16_t current = state;
+        for (uint64_t now = 1000000; !stop.load(std::memory_order_relaxed); now += 1000) {
+            history->record(current, static_cast<uint16_t>(~current), now);
+            current = static_cast<uint16_t>(~current);
+        }
+    });
+    benchOps(out, "press_history_last_while_recording", 20000000, [&](uint64_t i) {
+        g_sink += static_cast<uint32_t>(history->copy(static_cast<int>(i & 15), presses, 1));
+    });
+    benchOps(out, "press_history_all_while_recording", 2000000, [&](uint64_t i) {
+        g_sink += static_cast<uint32_t>(history->copy(static_cast<int>(i & 15), presses));
+    });
+    stop = true;
+    writer.join();
+}
+
+struct Session {
+    std::vector<uint64_t> latencies;
+};
+
+static Session* g_session = nullptr;
+
+static void callbackLatency(SDK::Player player, uint16_t, void*) {
+    // Events are queued before the callback runs, so the newest one carries this report's arrival time
+    SDK::InputEvent events[SDK::EVENT_QUEUE_CAPACITY];
+    size_t count = SDK::getInstance().drainEvents(player, events, SDK::EVENT_QUEUE_CAPACITY);
+    if (count > 0 && g_session->latencies.size() < g_session->latencies.capacity()) {
+        g_session->latencies.push_back(monotonicNanoseconds() - events[count - 1].timestamp_ns);
+    }
+}
+
+static bool startSimulatedSession(int report_rate_hz, SDK::InputCallback callback) {
+    // Every report is a transition, so every report reaches the callback and the event queue
+    static const uint16_t script[] = { DancePadAdapterInputLeft, DancePadAdapterInputNone };
+
+    SDK::SimulatedPad pad;
+    pad.kind = SDK::SimulatedPad::Kind::SMX;
+    pad.player = 0;
+    pad.report_rate_hz = report_rate_hz;
+    pad.script = script;
+    pad.script_length = sizeof(script) / sizeof(script[0]);
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = &pad;
+    options.simulated_pad_count = 1;
+    return SDK::getInstance().initialize(callback, nullptr, options);
+}
+
+static void writeSessionStats(JsonWriter& out, const SDK::LatencyStats& stats) {
+    out.field("reports", stats.reports);
+    out.field("dropped_events", stats.dropped_events);
+    out.field("converter_p99_ns", stats.converter_time.p99_ns);
+    out.field("report_interval_p99_ns", stats.report_interval.p99_ns);
+}
+
+static void benchEndToEndCallback(JsonWriter& out, const char* name, int report_rate_hz, double seconds) {
+    Session session;
+    session.latencies.reserve(static_cast<size_t>(report_rate_hz * seconds) + 1024);
+    g_session = &session;
+
+    if (!startSimulatedSession(report_rate_hz, callbackLatency)) {
+        fprintf(stderr, "%s: couldn't start the simulated backend\n", name);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+    // Stop the USB thread before touching the samples it was appending to
+    SDK::LatencyStats stats = SDK::getInstance().getLatencyStats(SDK::Player::P1);
+    SDK::getInstance().shutdown();
+    g_session = nullptr;
+
+    writeLatencies(out, name, session.latencies);
+    writeSessionStats(out, stats);
+    out.close();
+}
+
+// Report arrival to the game thread seeing it, with the game thread spinning on drainEvents()
+static void benchEndToEndPoll(JsonWriter& out, const char* name, int report_rate_hz, double seconds) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(static_cast<size_t>(report_rate_hz * seconds) + 1024);
+
+    if (!startSimulatedSession(report_rate_hz, nullptr)) {
+        fprintf(stderr, "%s: couldn't start the simulated backend\n", name);
+        return;
+    }
+    SDK& sdk = SDK::getInstance();
+    uint64_t end_ns = monotonicNanoseconds() + static_cast<uint64_t>(seconds * 1e9);
+    SDK::InputEvent events[SDK::EVENT_QUEUE_CAPACITY];
+    while (monotonicNanoseconds() < end_ns) {
+        size_t count = sdk.drainEvents(SDK::Player::P1, events, SDK::EVENT_QUEUE_CAPACITY);
+        uint64_t now = monotonicNanoseconds();
+        for (size_t i = 0; i < count; i++) {
+            latencies.push_back(now - events[i].timestamp_ns);
+        }
+    }
+    SDK::LatencyStats stats = sdk.getLatencyStats(SDK::Player::P1);
+    sdk.shutdown();
+
+    writeLatencies(out, name, latencies);
+    writeSessionStats(out, stats);
+    out.close();
+}
+
+#ifndef _WIN32
+// Report arrival to the game thread seeing it, with the game thread asleep in poll() on getInputFd()
+static void benchEndToEndFd(JsonWriter& out, const char* name, int report_rate_hz, double seconds) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(static_cast<size_t>(report_rate_hz * seconds) + 1024);
+
+    if (!startSimulatedSession(report_rate_hz, nullptr)) {
+        fprintf(stderr, "%s: couldn't start the simulated backend\n", name);
+        return;
+    }
+    SDK& sdk = SDK::getInstance();
+    uint64_t end_ns = monotonicNanoseconds() + static_cast<uint64_t>(seconds * 1e9);
+    SDK::InputEvent events[SDK::EVENT_QUEUE_CAPACITY];
+    pollfd input = { sdk.getInputFd(), POLLIN, 0 };
+    while (monotonicNanoseconds() < end_ns) {
+        if (poll(&input, 1, 100) <= 0) {
+            continue;
+        }
+        sdk.acknowledgeInput();
+        size_t count = sdk.drainEvents(SDK::Player::P1, events, SDK::EVENT_QUEUE_CAPACITY);
+        uint64_t now = monotonicNanoseconds();
+        for (size_t i = 0; i < count; i++) {
+            latencies.push_back(now - events[i].timestamp_ns);
+        }
+    }
+    SDK::LatencyStats stats = sdk.getLatencyStats(SDK::Player::P1);
+    sdk.shutdown();
+
+    writeLatencies(out, name, latencies);
+    writeSessionStats(out, stats);
+    out.close();
+}
+#endif
+
+// Time for initialize() to return with four pads that each take 50 ms to say which player they are, plus one
+// that takes 800 ms and so misses the startup deadline, and how long after that the slow one gets its slot
+static void benchStartup(JsonWriter& out) {
+    const int probe_delay_ms = 50;
+    const int slow_probe_delay_ms = 800;
+    SDK::SimulatedPad pads[5];
+    for (int i = 0; i < 5; i++) {
+        pads[i].kind = SDK::SimulatedPad::Kind::SMX;
+        pads[i].probe_delay_ms = i < 4 ? probe_delay_ms : slow_probe_delay_ms;
+        pads[i].port_path[0] = static_cast<uint8_t>(i + 1);
+    }
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = pads;
+    options.simulated_pad_count = 5;
+    options.max_devices = 5;
+
+    SDK& sdk = SDK::getInstance();
+    uint64_t start = monotonicNanoseconds();
+    if (!sdk.initialize(nullptr, nullptr, options)) {
+        fprintf(stderr, "startup: couldn't start the simulated backend\n");
+        return;
+    }
+    uint64_t initialized = monotonicNanoseconds();
+    int connected_at_start = 0;
+    for (int i = 0; i < 5; i++) {
+        connected_at_start += sdk.isPlayerConnected(static_cast<SDK::Player>(i));
+    }
+
+    uint64_t give_up = initialized + 2000000000ull;
+    while (!sdk.isPlayerConnected(SDK::Player::P5) && monotonicNanoseconds() < give_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint64_t late_attached = monotonicNanoseconds();
+    sdk.shutdown();
+
+    out.open("startup_5_pads");
+    out.field("probe_delay_ms", static_cast<uint64_t>(probe_delay_ms));
+    out.field("startup_timeout_ms", static_cast<uint64_t>(options.startup_timeout_ms));
+    out.field("initialize_ns", initialized - start);
+    out.field("connected_at_start", static_cast<uint64_t>(connected_at_start));
+    out.field("late_pad_attached_ns", late_attached - start);
+    out.close();
+}
+
+// initialize() with four pads that take 50 ms to say which player they are, first with an empty device
+// cache and then with the one that run left behind
+static void benchWarmStartup(JsonWriter& out) {
+    static const char* cache_path = "lowlatencydancegamesdk_bench_device_cache.txt";
+    SDK::SimulatedPad pads[4];
+    for (int i = 0; i < 4; i++) {
+        pads[i].kind = SDK::SimulatedPad::Kind::SMX;
+        pads[i].probe_delay_ms = 50;
+        pads[i].port_path[0] = static_cast<uint8_t>(i + 1);
+    }
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = pads;
+    options.simulated_pad_count = 4;
+    options.max_devices = 4;
+    options.device_cache_path = cache_path;
+
+    remove(cache_path);
+    uint64_t initialize_ns[2];
+    for (int run = 0; run < 2; run++) {
+        uint64_t start = monotonicNanoseconds();
+        if (!SDK::getInstance().initialize(nullptr, nullptr, options)) {
+            fprintf(stderr, "startup_device_cache: couldn't start the simulated backend\n");
+            remove(cache_path);
+            return;
+        }
+        initialize_ns[run] = monotonicNanoseconds() - start;
+        SDK::getInstance().shutdown();
+    }
+    remove(cache_path);
+
+    out.open("startup_device_cache_4_pads");
+    out.field("cold_initialize_ns", initialize_ns[0]);
+    out.field("warm_initialize_ns", initialize_ns[1]);
+    out.close();
+}
+
+// Report to callback with the session being recorded, from an SMX stage at 8 kHz and a HID pad beside it,
+// then how long the recording takes to replay and whether replay decodes every report the same way
+static void benchRecording(JsonWriter& out, double seconds) {
+    static const char* record_path = "lowlatencydancegamesdk_bench_recording.bin";
+    SDK::SimulatedPad pads[2];
+    pads[0].kind = SDK::SimulatedPad::Kind::SMX;
+    pads[0].player = 0;
+    pads[0].report_rate_hz = 8000;
+    pads[0].change_per_mille = 200;
+    pads[1].kind = SDK::SimulatedPad::Kind::HID;
+    pads[1].port_path[0] = 2;
+    pads[1].change_per_mille = 200;
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = pads;
+    options.simulated_pad_count = 2;
+    options.generic_hid = true;
+    options.record_path = record_path;
+
+    Session session;
+    session.latencies.reserve(static_cast<size_t>(9000 * seconds) + 1024);
+    g_session = &session;
+    if (!SDK::getInstance().initialize(callbackLatency, nullptr, options)) {
+        fprintf(stderr, "session_recording: couldn't start the simulated backend\n");
+        g_session = nullptr;
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    SDK::LatencyStats stats = SDK::getInstance().getLatencyStats(SDK::Player::P1);
+    SDK::getInstance().shutdown();
+    g_session = nullptr;
+
+    LowLatencyDanceGameRecording recording;
+    if (!recording.open(record_path)) {
+        fprintf(stderr, "session_recording: couldn't read the recording back\n");
+        remove(record_path);
+        return;
+    }
+    uint64_t records = 0;
+    LowLatencyDanceGameRecording::Record record;
+    while (recording.next(record)) {
+        records++;
+    }
+    uint64_t replay_start = monotonicNanoseconds();
+    LowLatencyDanceGameRecording::ReplayResult replayed = recording.replay(nullptr, nullptr);
+    uint64_t replay_ns = monotonicNanoseconds() - replay_start;
+    recording.close();
+
+    FILE* file = fopen(record_path, "rb");
+    uint64_t bytes = 0;
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        bytes = static_cast<uint64_t>(ftell(file));
+        fclose(file);
+    }
+    remove(record_path);
+
+    writeLatencies(out, "session_recording", session.latencies);
+    writeSessionStats(out, stats);
+    out.field("records", records);
+    out.field("bytes_per_record", records ? static_cast<double>(bytes) / records : 0.0);
+    out.field("replay_ns_per_record", records ? static_cast<double>(replay_ns) / records : 0.0);
+    out.field("replayed_reports", replayed.reports);
+    out.field("replay_mismatches", replayed.mismatches);
+    out.field("replay_undecodable", replayed.undecodable);
+    out.field("lost_records", replayed.lost);
+    out.close();
+}
+
+#ifdef __linux__
+static uint64_t processCpuNanoseconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (static_cast<uint64_t>(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000ull +
+           (static_cast<uint64_t>(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000ull;
+}
+
+// Real pads through one backend. Neither backend can say when its thread woke, so the comparison is the
+// spread of report arrival times (a slower or noisier wake shows up as completion jitter), arrival to
+// callback, and CPU spent per report while the main thread sleeps.
+static void benchHardware(JsonWriter& out, const char* name, SDK::Backend backend, double seconds) {
+    Session session;
+    session.latencies.reserve(static_cast<size_t>(8000 * seconds * SDK::MAX_PLAYERS) + 1024);
+    g_session = &session;
+
+    SDK& sdk = SDK::getInstance();
+    SDK::Options options;
+    options.backend = backend;
+    uint64_t cpu_start_ns = processCpuNanoseconds();
+    if (!sdk.initialize(callbackLatency, nullptr, options)) {
+        fprintf(stderr, "%s: no pads found\n", name);
+        g_session = nullptr;
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+    SDK::Player player = sdk.isPlayerConnected(SDK::Player::P1) ? SDK::Player::P1 : SDK::Player::P2;
+    SDK::LatencyStats stats = sdk.getLatencyStats(player);
+    sdk.shutdown();
+    uint64_t cpu_ns = processCpuNanoseconds() - cpu_start_ns;
+    g_session = nullptr;
+
+    writeLatencies(out, name, session.latencies);
+    writeSessionStats(out, stats);
+    out.field("completion_jitter_p50_ns", stats.completion_jitter.p50_ns);
+    out.field("completion_jitter_p99_ns", stats.completion_jitter.p99_ns);
+    out.field("cpu_ns_per_report", stats.reports ? static_cast<double>(cpu_ns) / stats.reports : 0.0);
+    out.close();
+}
+#endif
+
+#ifdef LLDGSDK_AUDIT
+// Steady-state streaming from one of each kind of simulated pad, with the game thread draining events and
+// sending lights the way a game would. Returns false if anything was counted beyond the input fd's budget.
+static bool auditHotPath(JsonWriter& out, double seconds) {
+    SDK::SimulatedPad pads[3];
+    pads[0].kind = SDK::SimulatedPad::Kind::SMX;
+    pads[0].player = 0;
+    pads[0].report_rate_hz = 8000;
+    pads[1].kind = SDK::SimulatedPad::Kind::Foam;
+    pads[1].port_path[0] = 2;
+    pads[2].kind = SDK::SimulatedPad::Kind::HID;
+    pads[2].port_path[0] = 3;
+    for (SDK::SimulatedPad& pad : pads) {
+        pad.change_per_mille = 200;
+    }
+
+    SDK& sdk = SDK::getInstance();
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = pads;
+    options.simulated_pad_count = 3;
+    options.generic_hid = true;
+    options.max_devices = 3;
+    if (!sdk.initialize(nullptr, nullptr, options)) {
+        fprintf(stderr, "audit: couldn't start the simulated backend\n");
+        return false;
+    }
+
+    SDK::LightsFrame lights;
+    lights.command_count = 1;
+    lights.command_size[0] = 2;
+    lights.data[0] = '2';
+    lights.data[1] = '\n';
+
+    // With `wait_on_fd`, the game sleeps in poll() on getInputFd() and acknowledges each wakeup, so the USB
+    // thread takes the armed path that writes to it; otherwise it never acknowledges, and nothing is written
+    SDK::InputEvent events[SDK::EVENT_QUEUE_CAPACITY];
+    uint64_t wakeups = 0;
+    auto run = [&](double run_seconds, bool wait_on_fd) {
+        uint64_t end_ns = monotonicNanoseconds() + static_cast<uint64_t>(run_seconds * 1e9);
+        uint64_t next_lights_ns = 0;
+#ifndef _WIN32
+        pollfd input = { sdk.getInputFd(), POLLIN, 0 };
+#endif
+        while (monotonicNanoseconds() < end_ns) {
+#ifndef _WIN32
+            if (wait_on_fd) {
+                if (poll(&input, 1, 1) > 0) {
+                    sdk.acknowledgeInput();
+                    wakeups++;
+                }
+            } else
+#endif
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            for (int player = 0; player < sdk.getDeviceCount(); player++) {
+                sdk.drainEvents(static_cast<SDK::Player>(player), events, SDK::EVENT_QUEUE_CAPACITY);
+            }
+            if (monotonicNanoseconds() >= next_lights_ns) {
+                sdk.submitLights(SDK::Player::P1, lights);
+                next_lights_ns = monotonicNanoseconds() + 1000000000 / 30;
+            }
+        }
+    };
+
+    // Warm up first, so one-time work like the first lights frame isn't counted
+    run(0.2, false);
+    hotPathAuditReset();
+    run(seconds / 2, false);
+    run(seconds / 2, true);
+    HotPathAuditCounts counts = hotPathAuditCounts();
+    sdk.shutdown();
+
+    // The input fd write is the one syscall allowed: at most one per acknowledged wakeup, plus the one that
+    // was armed before counting started (see HotPathAudit.h)
+    bool notified = counts.notifies > 0 && counts.notifies <= wakeups + 1;
+    bool clean = counts.reports > 0 && counts.allocations == 0 && counts.lock_acquisitions == 0 &&
+                 counts.syscalls == 0 && notified;
+    out.open("hot_path_audit");
+    out.field("reports", counts.reports);
+    out.field("allocations", counts.allocations);
+    out.field("lock_acquisitions", counts.lock_acquisitions);
+    out.field("syscalls", counts.syscalls);
+    out.field("input_fd_writes", counts.notifies);
+    out.field("input_fd_wakeups", wakeups);
+    out.field("passed", static_cast<uint64_t>(clean));
+    out.close();
+    return clean;
+}
+#endif
+
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    bool hardware = false;
+    bool audit = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hardware") == 0) {
+            hardware = true;
+        } else if (strcmp(argv[i], "--audit") == 0) {
+            audit = true;
+        } else {
+            fprintf(stderr, "usage: %s [--seconds N] [--hardware | --audit]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    JsonWriter out;
+    if (audit) {
+#ifdef LLDGSDK_AUDIT
+        out.begin();
+        bool clean = auditHotPath(out, seconds);
+        out.end();
+        return clean ? 0 : 1;
+#else
+        fprintf(stderr, "--audit needs a build configured with -DLLDGSDK_AUDIT=ON\n");
+        return 2;
+#endif
+    }
+    if (hardware) {
+#ifdef __linux__
+        out.begin();
+        benchHardware(out, "hardware_libusb", SDK::Backend::Libusb, seconds);
+        benchHardware(out, "hardware_usbfs", SDK::Backend::Usbfs, seconds);
+        out.end();
+        return 0;
+#else
+        fprintf(stderr, "--hardware needs the usbfs backend, which is Linux only\n");
+        return 2;
+#endif
+    }
+
+    out.begin();
+    benchConverters(out);
+    benchAdapterLookup(out);
+    benchAtomicState(out);
+    benchPressHistory(out);
+    benchSnapshot(out);
+    benchStartup(out);
+    benchWarmStartup(out);
+    benchEndToEndCallback(out, "e2e_report_to_callback_1000hz", 1000, seconds);
+    benchEndToEndCallback(out, "e2e_report_to_callback_8000hz", 8000, seconds);
+    benchEndToEndPoll(out, "e2e_report_to_drain_1000hz", 1000, seconds);
+    benchRecording(out, seconds);
+#ifndef _WIN32
+    benchEndToEndFd(out, "e2e_report_to_input_fd_1000hz", 1000, seconds);
+#endif
+    out.end();
+    return 0;
+}
@@ -1,29 +1,343 @@
 #ifndef LOWLATENCYDANCEGAMESDK_H
 #define LOWLATENCYDANCEGAMESDK_H
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 
 class LowLatencyDanceGameSDK {
 public:
+    // Any index below getDeviceCount() is a valid player, so setups with more pads than are named here
+    // can use static_cast<Player>(index)
     enum class Player {
         P1 = 0,
         P2,
+        P3,
+        P4,
+        P5,
+        P6,
+        P7,
+        P8,
     };
     
     using InputCallback = void(*)(Player player, uint16_t button_state, void* user_data);
     
-    static constexpr int MAX_PLAYERS = 2;
+    // A single change of a player's button state, as seen by the USB thread
+    struct InputEvent {
+        uint16_t button_state;
+        uint64_t timestamp_ns; // Arrival time on the monotonic clock (std::chrono::steady_clock)
+        uint64_t sequence;     // Per-player transition counter; a gap means events were dropped
+        double game_time;      // Arrival time on the game clock (see GameClock), if has_game_time
+        bool has_game_time;
+    };
+    
+    // One press of a panel, on the monotonic clock
+    struct Press {
+        uint64_t press_ns;
+        uint64_t release_ns; // 0 while the panel is still held
+    };
+    
+    // Percentiles of one measured duration. Values are bucketed, so they are accurate to within 12.5%.
+    struct LatencySummary {
+        uint64_t count;
+        uint64_t p50_ns;
+        uint64_t p99_ns;
+        uint64_t p999_ns;
+        uint64_t max_ns;
+    };
+    
+    // How a pad's input path has behaved since initialize(). Safe to read from any thread at any time.
+    struct LatencyStats {
+        LatencySummary report_interval;   // Time between consecutive input reports
+        LatencySummary completion_jitter; // Change in report_interval from one report to the next
+        LatencySummary converter_time;    // Time spent in the adapter's input converter
+        LatencySummary callback_time;     // Time spent in the user's InputCallback
+        uint64_t reports;                 // Input reports received
+        uint64_t timeouts;                // Transfers that timed out without a report
+        uint64_t errors;                  // Transfers that failed, e.g. because the pad was unplugged
+        uint64_t dropped_events;          // Transitions lost because drainEvents() fell behind
+    };
+    
+    // Where the SDK gets its pads from
+    enum class Backend {
+        Libusb,    // Real pads over USB
+        Simulated, // Emulated pads described by Options::simulated_pads, for running without hardware
+        Usbfs,     // Linux only: real pads driven through usbfs directly, without libusb's event handling
+    };
+    
+    // A pad emulated by the Simulated backend. It speaks the same report format as the real pad, so the
+    // whole SDK (adapters, discovery and slot ordering included) runs exactly as it would over USB.
+    struct SimulatedPad {
+        enum class Kind {
+            SMX,
+            Foam,
+            HID, // A standard HID gamepad with no adapter of its own, recognised from its report descriptor
+        };
+        Kind kind = Kind::SMX;
+        int report_rate_hz = 1000;         // 0 means the pad never reports, so every transfer times out
+        int player = -1;                   // SMX player-ID reply: 0 for P1, 1 for P2, -1 to not answer
+        int probe_delay_ms = 0;            // How long the SMX player-ID reply takes, to stand in for a slow pad
+        uint8_t bus_number = 1;
+        uint8_t port_path[8] = {1};
+        int port_path_length = 1;
+        const uint16_t* script = nullptr;  // Button states reported in order, looping; must outlive the SDK session
+        size_t script_length = 0;          // 0 reports random input instead
+        uint32_t random_seed = 1;
+        int change_per_mille = 50;         // Random input: chance per report that one panel toggles
+        
+        // SMX pads: called with every command the pad receives, lights frames included, as its last packet
+        // arrives. Runs on the USB thread, so tests can see what reached the pad and when.
+        void (*on_command)(const uint8_t* command, size_t length, void* user_data) = nullptr;
+        void* on_command_user_data = nullptr;
+        
+        // Refuse the nth submission of an input transfer (counting from 1, over every time the pad is opened)
+        // once, as a host controller error would. 0 never refuses one.
+        int fail_input_submit = 0;
+    };
+    
+    // A clock the game judges input against, such as its audio playback position. The SDK keeps estimating
+    // the offset and drift between it and the monotonic clock, and stamps every InputEvent with it.
+    struct GameClock {
+        // Returns the game clock's current time. Called on the USB thread every sample_interval_ms, so it
+        // must be safe to call from there. Leave it null to feed samples through addGameClockSample() instead.
+        double (*read)(void* user_data) = nullptr;
+        void* user_data = nullptr;
+        int sample_interval_ms = 100;
+        
+        // Nominal rate, used until enough samples have come in to measure the real one. 1.0 for a clock
+        // in seconds, 48000.0 for one counting audio frames at 48 kHz.
+        double units_per_second = 1.0;
+    };
+    
+    // How the SDK's USB thread runs. None of these stop initialize() if they can't be applied; see
+    // ThreadReport for what actually took effect.
+    struct ThreadOptions {
+        enum class Scheduling {
+            Normal,     // The OS default
+            RealTime,   // SCHED_FIFO on POSIX, THREAD_PRIORITY_TIME_CRITICAL on Windows
+            RoundRobin, // SCHED_RR on POSIX; the same as RealTime on Windows
+        };
+        Scheduling scheduling = Scheduling::RealTime;
+        int priority = -1; // POSIX real-time priority, or -1 for the highest the policy allows
+        
+        // Bit n allows the thread on CPU n, e.g. to pin it to a core isolated from audio threads. 0 leaves
+        // it wherever the OS puts it. Not supported on macOS.
+        uint64_t cpu_affinity = 0;
+        
+        // Lock the thread's stack and the SDK's per-pad buffers into RAM, so input never waits on a page
+        // fault. POSIX only, and usually needs RLIMIT_MEMLOCK raised or CAP_IPC_LOCK.
+        bool lock_memory = false;
+        
+        // Spin checking for completions instead of sleeping until one arrives. Saves the wakeup on every
+        // report at the cost of a whole core. At real-time priority the spinning thread starves anything
+        // else on its core, so pin it with cpu_affinity to a core nothing else needs.
+        bool busy_poll = false;
+    };
+    
+    // What the USB thread ended up with. Errors are errno values (GetLastError() on Windows); 0 means the
+    // setting wasn't asked for or succeeded.
+    struct ThreadReport {
+        ThreadOptions::Scheduling scheduling; // Policy in effect
+        int priority;                         // Priority in effect
+        int scheduling_error;                 // E.g. EPERM when real-time scheduling was denied
+        uint64_t cpu_affinity;                // Mask in effect, 0 if unpinned
+        int affinity_error;
+        bool memory_locked;
+        int memory_lock_error;
+        bool busy_poll;
+    };
+    
+    struct Options {
+        // Interrupt-IN transfers kept in flight per pad. More than one means a report never waits
+        // behind the resubmission of the previous one.
+        int transfer_queue_depth = 4;
+        
+        // How often to look for replugged pads when libusb can't deliver hotplug events, or after a
+        // pad dropped out without being unplugged. 0 disables rescanning.
+        int rescan_interval_ms = 1000;
+        
+        // Minimum spacing between lights frames sent to one pad. SMX panels don't update faster than 30 FPS.
+        int lights_min_interval_us = 1000000 / 30;
+        
+        // File describing extra pads by VID/PID (see src/adapters/AdapterMappingFile.h for the format).
+        // initialize() fails if it can't be loaded.
+        const char* adapter_mappings_path = nullptr;
+        
+        // How long initialize() waits for pads to answer their probes. Pads are probed all at once, each on a
+        // thread of its own, so startup takes as long as the slowest pad up to this limit. One that answers
+        // later still gets a slot as soon as it does; initialize() only fails if no pad was found at all.
+        int startup_timeout_ms = 500;
+        
+        // File the SDK remembers each pad in by USB port: its interface, endpoints and player. A pad found
+        // where the file says it was is opened directly and put back in the same slot, without asking it
+        // its player, and then asked again in the background once it's streaming; an answer that changed
+        // is saved for next time. Read by initialize() and rewritten when it changes by initialize() and
+        // shutdown(). Null turns the cache off.
+        const char* device_cache_path = nullptr;
+        
+        // File to record the session to: every report from every pad and the state the SDK published
+        // after it, with timestamps, plus pads coming and going. Read it back with
+        // LowLatencyDanceGameRecording (lowlatencydancegamesdk_recording.h). Reports are only copied into a
+        // buffer on the USB thread, and written out by a thread of the recorder's own. Any existing file is
+        // replaced; initialize() fails if it can't be created. Null turns recording off.
+        const char* record_path = nullptr;
+        
+        // Also use pads with no adapter that describe themselves as a standard HID joystick or gamepad.
+        // Off by default: an ordinary gamepad or joystick describes itself the same way, and using one takes
+        // it from the OS, so the game would lose it as a controller. Only a device's first HID interface
+        // that isn't a boot keyboard or mouse is considered. On Linux its report descriptor is read from the
+        // kernel's copy and only a pad is opened; elsewhere each candidate is opened once to read it, and
+        // anything else is handed straight back. At startup, pads with an adapter get slots first.
+        bool generic_hid = false;
+        
+        // Number of player slots, from 1 to MAX_DEVICES. Pads are still ordered by their own player
+        // setting or by USB port, so the first two slots behave the same whatever this is.
+        int max_devices = MAX_PLAYERS;
+        
+        // Stamp events with a game clock too. Off unless `read` is set or samples are added.
+        GameClock game_clock;
+        
+        ThreadOptions thread;
+        
+        Backend backend = Backend::Libusb;
+        const SimulatedPad* simulated_pads = nullptr; // Copied by initialize()
+        int simulated_pad_count = 0;
+    };
+    
+    // One update of a pad's lights: a few adapter-specific commands, stored back to back in `data`
+    struct LightsFrame {
+        static constexpr int MAX_COMMANDS = 4;
+        static constexpr size_t MAX_SIZE = 1024;
+        int command_count = 0;
+        uint16_t command_size[MAX_COMMANDS] = {};
+        uint8_t data[MAX_SIZE];
+    };
+    
+    // A pad's answer to a command (see sendCommand and setRepeatingCommand)
+    struct CommandResponse {
+        static constexpr size_t MAX_SIZE = 1024;
+        size_t size;
+        uint8_t data[MAX_SIZE]; // Payload of every packet in the response, back to back
+        uint64_t timestamp_ns;  // Arrival of the last packet, on the monotonic clock
+        uint64_t sequence;      // Repeating commands: responses received since the command was set, from 0
+    };
+    
+    // Called on the USB thread each time a repeating command's response arrives
+    using ResponseCallback = void(*)(Player player, void* user_data);
+    
+    // Called once for every command sendCommand() accepted, on the USB thread (or in shutdown()). `sent` is
+    // false if the command never made it to the pad, e.g. because it was unplugged. `response` is the pad's
+    // answer, or nullptr if it only acknowledged the command or stopped responding; it's only valid during the call.
+    using CommandCallback = void(*)(Player player, bool sent, const CommandResponse* response, void* user_data);
+    
+    static constexpr int MAX_PLAYERS = 2;  // Default number of player slots
+    static constexpr int MAX_DEVICES = 16; // Most player slots Options::max_devices can ask for
+    static constexpr size_t EVENT_QUEUE_CAPACITY = 256;
+    static constexpr size_t COMMAND_QUEUE_CAPACITY = 8;
+    static constexpr size_t PRESS_HISTORY_LENGTH = 16; // Presses kept per panel
+    
+    // One player's state, as part of a Snapshot
+    struct PlayerSnapshot {
+        uint16_t button_state;
+        bool connected;
+        uint64_t sequence;       // Transitions so far; the newest InputEvent's sequence is one less
+        uint64_t last_change_ns; // When button_state last changed, on the monotonic clock; 0 if it hasn't
+    };
+    
+    // Every player's state as of one instant
+    struct Snapshot {
+        int device_count;  // Players below this are valid, as with getDeviceCount()
+        uint64_t version;  // Changes whenever anything in `players` does
+        PlayerSnapshot players[MAX_DEVICES];
+    };
+    
     static LowLatencyDanceGameSDK& getInstance();
 
     static bool isPadCompatible(uint16_t vendor_id, uint16_t product_id);
     
     bool initialize(InputCallback callback, void* user_data);
+    bool initialize(InputCallback callback, void* user_data, const Options& options);
     void shutdown();
     
+    // Number of player slots in the current session, or 0 when not initialized
+    int getDeviceCount();
+    
+    // How Options::thread was applied, as of the last successful initialize()
+    ThreadReport getThreadReport();
+    
+    // A descriptor that polls readable once input has changed since the last acknowledgeInput(), so an
+    // epoll/poll/select loop can wait on input instead of spinning. Call acknowledgeInput() before reading
+    // input through drainEvents() or the accessors; any change after that makes the descriptor readable
+    // again. It's created by the first initialize() and then stays the same for the life of the process;
+    // don't close or read it yourself. Returns -1 before that, on Windows, or if it couldn't be created.
+    int getInputFd();
+    void acknowledgeInput();
+    
+    // The clock InputEvent::timestamp_ns is on
+    static uint64_t getMonotonicTime();
+    
+    // Tells the SDK the game clock read `game_time` at `monotonic_ns` (from getMonotonicTime()), for games
+    // that can't have their clock read from the USB thread. Call from one thread, every 100 ms or so; a
+    // jump in the game clock, like a song restarting, is detected and starts the estimate over.
+    // Returns false if the SDK isn't initialized or the sample couldn't be queued.
+    bool addGameClockSample(double game_time, uint64_t monotonic_ns);
+    
+    // Copies every player's state into `snapshot`, all as of the same instant, which reading players one by
+    // one can't promise. Never waits on the USB thread: it only copies again if a pad's state changed while
+    // it was copying. Any number of threads may take snapshots at once.
+    void snapshot(Snapshot& snapshot);
+    
     bool isPlayerConnected(Player player);
     uint16_t getPlayerButtonState(Player player);
     
+    // Copies up to `max_events` queued transitions for `player` into `events`, oldest first, and
+    // returns how many were copied. Lock-free; only one thread may drain a given player.
+    size_t drainEvents(Player player, InputEvent* events, size_t max_events);
+    
+    // Hands `frame` to the USB thread to send to `player`'s pad. Only the newest unsent frame is kept, so
+    // this can be called at any rate without queueing up stale lights. Call from one thread at a time.
+    // Returns false if the pad isn't connected or doesn't accept commands.
+    bool submitLights(Player player, const LightsFrame& frame);
+    
+    // Queues one adapter-specific command, like a pad configuration write, for `player`'s pad. Queued
+    // commands go out in order, one at a time, between lights frames and ahead of any repeating command,
+    // and never hold up input. Call from one thread at a time. Returns false if the pad isn't connected or
+    // doesn't accept commands, the command is longer than LightsFrame::MAX_SIZE, or COMMAND_QUEUE_CAPACITY
+    // commands are already waiting.
+    bool sendCommand(Player player, const uint8_t* command, size_t length,
+                     CommandCallback callback = nullptr, void* user_data = nullptr);
+    
+    // Keeps sending one adapter-specific command to `player`'s pad: it goes out again each time the pad is
+    // done with it, in between lights frames, so its response refreshes as fast as the pad can produce one.
+    // This is how sensor readings are streamed. Each response is published to getRepeatingResponse() and then
+    // `callback`, if set, is called. A null or empty command stops it. The command stays set through a replug
+    // until shutdown(). Call from one thread at a time. Returns false if the player doesn't exist or the
+    // command is longer than LightsFrame::MAX_SIZE.
+    bool setRepeatingCommand(Player player, const uint8_t* command, size_t length,
+                             ResponseCallback callback = nullptr, void* user_data = nullptr);
+    
+    // Copies the newest response to the current repeating command into `response`. Lock-free; returns false
+    // if none has arrived since the command was set. Only one thread may read a given player's responses.
+    bool getRepeatingResponse(Player player, CommandResponse& response);
+    
+    // Press history, for judging input against timing windows. Each player keeps the last PRESS_HISTORY_LENGTH
+    // presses of every panel for the session, updated as button states are published, so it agrees with
+    // getPlayerButtonState() and drainEvents(). `panel` is the panel's bit number in button_state (0 to 15).
+    // Every query is wait-free, and any number of threads may query at once.
+    
+    // The most recent press of `panel`; false if it hasn't been pressed this session
+    bool getLastPress(Player player, int panel, Press& press);
+    
+    // Copies the presses of `panel` that began in [from_ns, to_ns) into `presses`, oldest first, and returns how
+    // many were copied. Only the last PRESS_HISTORY_LENGTH presses are kept, so a window reaching further
+    // back than that sees just those.
+    size_t getPresses(Player player, int panel, uint64_t from_ns, uint64_t to_ns, Press* presses, size_t max_presses);
+    
+    // How long `panel` has been held, or 0 if it isn't
+    uint64_t getHoldDuration(Player player, int panel);
+    
+    LatencyStats getLatencyStats(Player player);
+    
 private:
     LowLatencyDanceGameSDK();
     ~LowLatencyDanceGameSDK();
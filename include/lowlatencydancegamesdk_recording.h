@@ -0,0 +1,90 @@
+#ifndef LOWLATENCYDANCEGAMESDK_RECORDING_H
+#define LOWLATENCYDANCEGAMESDK_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Reads back a session recorded with LowLatencyDanceGameSDK::Options::record_path, for working out after
+// the fact what a pad sent and what the SDK made of it. Works without the SDK being initialized, and
+// without the pads.
+class LowLatencyDanceGameRecording {
+public:
+    enum class RecordType {
+        Report = 1, // A report from the pad, and the button state the SDK published after it
+        Release,    // A held-back release expiring between reports (see DancePadAdapter::release_hold_us)
+        Attach,     // A pad took `player`'s slot
+        Detach,     // The pad in `player`'s slot went away, releasing every panel
+        Descriptor, // Part of the report descriptor of the HID pad attached just before
+        Gap,        // The recorder fell behind and lost `lost` records here
+    };
+
+    static constexpr size_t MAX_DATA_SIZE = 64;
+
+    struct Record {
+        RecordType type;
+        int player;
+        uint64_t timestamp_ns;   // On the monotonic clock of the recording session
+        uint16_t button_state;   // Report and Release: the state the SDK published
+
+        // Report: the report's bytes, with any past MAX_DATA_SIZE cut off. Descriptor: the next part of the
+        // descriptor.
+        uint8_t data[MAX_DATA_SIZE];
+        size_t length;
+        size_t original_length;  // Report: how long the report really was
+
+        // Attach
+        uint16_t vendor_id;
+        uint16_t product_id;
+        uint32_t release_hold_us;
+        size_t descriptor_length; // Bytes in the Descriptor records that follow
+        uint8_t bus_number;
+        uint8_t port_path[8];
+        int port_path_length;
+
+        uint64_t lost;           // Gap
+    };
+
+    // Called by replay() for each change of a player's button state, in recorded order
+    using ReplayCallback = void(*)(int player, uint16_t button_state, uint64_t timestamp_ns, void* user_data);
+
+    struct ReplayResult {
+        uint64_t reports;
+        uint64_t transitions; // Changes of button state
+        uint64_t mismatches;  // Reports or releases whose replayed state isn't what was recorded
+        uint64_t undecodable; // Reports from a pad with no adapter in this build
+        uint64_t lost;        // Records the recorder lost, from Gap records
+    };
+
+    LowLatencyDanceGameRecording();
+    ~LowLatencyDanceGameRecording();
+
+    // Fails if the file can't be read or isn't a recording. A recording cut short, say by a crash, opens
+    // fine and ends at the last record that was written whole.
+    bool open(const char* path);
+    void close();
+
+    // When recording started, on the session's monotonic clock and on the wall clock in nanoseconds since
+    // the Unix epoch
+    uint64_t getStartTime();
+    uint64_t getStartUnixTime();
+
+    // Reads the next record; false at the end of the recording
+    bool next(Record& record);
+    void rewind();
+
+    // Runs the whole recording back through the adapters and release filtering the SDK uses, from the
+    // start, and checks each state against the recorded one. Pads are looked up by VID/PID in this
+    // process's adapter registry, so register the same mapping files the recording session had first.
+    // Replaying a recording always gives the same result. Leaves the read position at the end.
+    ReplayResult replay(ReplayCallback callback, void* user_data);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+
+    LowLatencyDanceGameRecording(const LowLatencyDanceGameRecording&) = delete;
+    LowLatencyDanceGameRecording& operator=(const LowLatencyDanceGameRecording&) = delete;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LLDGSDK_CLOCKESTIMATOR_H
+#define LLDGSDK_CLOCKESTIMATOR_H
+
+#include <cmath>
+#include <cstdint>
+
+// Maps the monotonic clock onto a game's own clock (an audio position, say) from (monotonic, game) sample
+// pairs. A least-squares line through the most recent samples gives both the offset and the drift between
+// the two, and averages out the steps an audio clock advances in. Used from one thread.
+class ClockEstimator {
+public:
+    // `units_per_second` is the game clock's nominal rate, used until there are enough samples to measure it
+    void configure(double units_per_second) {
+        nominal_rate_ = units_per_second / 1e9;
+        reset();
+    }
+
+    void reset() {
+        count_ = 0;
+        next_ = 0;
+        rate_ = nominal_rate_;
+    }
+
+    bool valid() const { return count_ > 0; }
+
+    void addSample(uint64_t monotonic_ns, double game_time) {
+        // A clock that jumped (a song restarted, playback was seeked) makes the old samples useless
+        if (valid() && std::fabs(toGameTime(monotonic_ns) - game_time) > nominal_rate_ * k_jump_ns) {
+            reset();
+        }
+        samples_[next_] = { monotonic_ns, game_time };
+        next_ = (next_ + 1) % k_window;
+        if (count_ < k_window) {
+            count_++;
+        }
+        fit();
+    }
+
+    double toGameTime(uint64_t monotonic_ns) const {
+        return base_game_ + static_cast<double>(static_cast<int64_t>(monotonic_ns - base_ns_)) * rate_;
+    }
+
+    // Measured game clock units per second
+    double rate() const { return rate_ * 1e9; }
+
+private:
+    static constexpr int k_window = 32;
+    static constexpr double k_jump_ns = 50e6;        // Disagreement with the fit that counts as a jump
+    static constexpr double k_min_span_ns = 500e6;   // Samples closer than this can't tell drift from jitter
+
+    struct Sample {
+        uint64_t monotonic_ns;
+        double game_time;
+    };
+
+    void fit() {
+        int oldest = (next_ - count_ + k_window) % k_window;
+        base_ns_ = samples_[oldest].monotonic_ns;
+
+        double mean_x = 0, mean_y = 0;
+        for (int i = 0; i < count_; i++) {
+            const Sample& sample = samples_[(oldest + i) % k_window];
+            mean_x += static_cast<double>(static_cast<int64_t>(sample.monotonic_ns - base_ns_));
+            mean_y += sample.game_time;
+        }
+        mean_x /= count_;
+        mean_y /= count_;
+
+        double sxx = 0, sxy = 0;
+        for (int i = 0; i < count_; i++) {
+            const Sample& sample = samples_[(oldest + i) % k_window];
+            double dx = static_cast<double>(static_cast<int64_t>(sample.monotonic_ns - base_ns_)) - mean_x;
+            sxx += dx * dx;
+            sxy += dx * (sample.game_time - mean_y);
+        }
+
+        // The spread of x is roughly span / sqrt(12); below the minimum span keep the nominal rate
+        double min_sxx = count_ * (k_min_span_ns * k_min_span_ns) / 12;
+        rate_ = (count_ >= 2 && sxx >= min_sxx) ? sxy / sxx : nominal_rate_;
+        base_game_ = mean_y - rate_ * mean_x;
+    }
+
+    Sample samples_[k_window] = {};
+    int count_ = 0;
+    int next_ = 0;
+    double nominal_rate_ = 1e-9; // Game units per nanosecond
+    double rate_ = 1e-9;
+    uint64_t base_ns_ = 0;
+    double base_game_ = 0;
+};
+
+#endif
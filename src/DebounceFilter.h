@@ -0,0 +1,78 @@
+#ifndef LLDGSDK_DEBOUNCEFILTER_H
+#define LLDGSDK_DEBOUNCEFILTER_H
+
+#include <cstdint>
+
+// Per-panel chatter filter for a pad's button state. Presses go through on the first report that has
+// them; a release is only reported once the panel has read released for `release_hold_ns` in a row, so
+// a contact that bounces while held never shows up as release/press pairs. Used from one thread, with
+// no allocation.
+class DebounceFilter {
+public:
+    // A hold of 0 turns the filter off, so every report's state is passed straight through
+    void configure(uint64_t release_hold_ns) {
+        hold_ns_ = release_hold_ns;
+        reset();
+    }
+
+    void reset() {
+        state_ = 0;
+        pending_ = 0;
+    }
+
+    // Takes the state from a report that arrived at `now_ns` and returns the state to publish
+    uint16_t filter(uint16_t raw, uint64_t now_ns) {
+        if (hold_ns_ == 0) {
+            state_ = raw;
+            return state_;
+        }
+
+        // A panel that reads pressed again was only bouncing
+        pending_ &= static_cast<uint16_t>(~raw);
+
+        uint16_t released = static_cast<uint16_t>(state_ & ~raw & ~pending_);
+        for (int bit = 0; released; bit++, released >>= 1) {
+            if (released & 1) {
+                released_at_ns_[bit] = now_ns;
+            }
+        }
+        pending_ |= static_cast<uint16_t>(state_ & ~raw);
+        state_ |= raw;
+        return expire(now_ns);
+    }
+
+    // Reports the releases that have been held long enough by `now_ns`
+    uint16_t expire(uint64_t now_ns) {
+        uint16_t pending = pending_;
+        for (int bit = 0; pending; bit++, pending >>= 1) {
+            if ((pending & 1) && now_ns - released_at_ns_[bit] >= hold_ns_) {
+                uint16_t mask = static_cast<uint16_t>(1u << bit);
+                pending_ &= static_cast<uint16_t>(~mask);
+                state_ &= static_cast<uint16_t>(~mask);
+            }
+        }
+        return state_;
+    }
+
+    bool hasPendingReleases() const { return pending_ != 0; }
+
+    // When the next pending release is due. Only meaningful while hasPendingReleases().
+    uint64_t nextDeadline() const {
+        uint64_t deadline = UINT64_MAX;
+        uint16_t pending = pending_;
+        for (int bit = 0; pending; bit++, pending >>= 1) {
+            if ((pending & 1) && released_at_ns_[bit] + hold_ns_ < deadline) {
+                deadline = released_at_ns_[bit] + hold_ns_;
+            }
+        }
+        return deadline;
+    }
+
+private:
+    uint64_t hold_ns_ = 0;
+    uint16_t state_ = 0;   // What has been published
+    uint16_t pending_ = 0; // Panels published as pressed that currently read released
+    uint64_t released_at_ns_[16] = {};
+};
+
+#endif
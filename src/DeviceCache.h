@@ -0,0 +1,182 @@
+#ifndef LLDGSDK_DEVICECACHE_H
+#define LLDGSDK_DEVICECACHE_H
+
+#include "transport/PadTransport.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// What was learned about a pad the last time it was set up, keyed by the USB port it was plugged into
+struct DeviceCacheEntry {
+    uint8_t bus_number = 0;
+    uint8_t port_path[8] = {0};
+    int port_path_length = 0;
+    uint16_t vendor_id = 0;
+    uint16_t product_id = 0;
+    PadConnection layout;      // HID interface and interrupt endpoints
+    int preferred_player = -1; // What the pad said its player was
+    int slot = -1;             // The player it ended up as
+};
+
+// The device cache file: one line per port, written whole to a temporary file and renamed over the old
+// one, so a process killed mid-write leaves the previous cache behind. Numbers are decimal except the
+// port path, which is dotted, and the IDs and endpoints, which are hex.
+//
+//   pad <bus> <port path> <vid> <pid> <interface> <in endpoint> <in size> <out endpoint> <out size> <player> <slot>
+//
+// Anything that doesn't parse is skipped; the worst a bad line can do is send its pad through a full probe.
+class DeviceCache {
+public:
+    // A missing file is an empty cache
+    void load(const char* path) {
+        entries_.clear();
+        dirty_ = false;
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            return;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            DeviceCacheEntry entry;
+            if (parse(line, &entry)) {
+                update(entry);
+            }
+        }
+        fclose(file);
+        dirty_ = false;
+    }
+
+    bool save(const char* path) {
+        std::string temporary = std::string(path) + ".tmp";
+        FILE* file = fopen(temporary.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        fprintf(file, "# lowlatencydancegamesdk device cache; rewritten by the SDK\n");
+        for (const DeviceCacheEntry& entry : entries_) {
+            char port_path[32] = "";
+            for (int i = 0; i < entry.port_path_length; i++) {
+                size_t used = strlen(port_path);
+                snprintf(port_path + used, sizeof(port_path) - used, i ? ".%u" : "%u", entry.port_path[i]);
+            }
+            fprintf(file, "pad %u %s 0x%04x 0x%04x %u 0x%02x %d 0x%02x %d %d %d\n",
+                    entry.bus_number, port_path, entry.vendor_id, entry.product_id,
+                    entry.layout.hid_interface, entry.layout.interrupt_in_endpoint, entry.layout.in_packet_size,
+                    entry.layout.interrupt_out_endpoint, entry.layout.out_packet_size,
+                    entry.preferred_player, entry.slot);
+        }
+        bool written = fflush(file) == 0;
+        written = fclose(file) == 0 && written;
+        if (!written || rename(temporary.c_str(), path) != 0) {
+            remove(temporary.c_str());
+            return false;
+        }
+        dirty_ = false;
+        return true;
+    }
+
+    // The entry for whatever is plugged in where `info` is, if it's the same kind of device as last time
+    const DeviceCacheEntry* find(const PadDeviceInfo& info) const {
+        int index = indexOf(info.bus_number, info.port_path, info.port_path_length);
+        if (index >= 0 && entries_[index].vendor_id == info.vendor_id && entries_[index].product_id == info.product_id) {
+            return &entries_[index];
+        }
+        return nullptr;
+    }
+
+    // Only allocates when the port is new to the cache
+    void update(const DeviceCacheEntry& entry) {
+        int index = indexOf(entry.bus_number, entry.port_path, entry.port_path_length);
+        if (index < 0) {
+            entries_.push_back(entry);
+            dirty_ = true;
+        } else if (!same(entries_[index], entry)) {
+            entries_[index] = entry;
+            dirty_ = true;
+        }
+    }
+
+    void forget(uint8_t bus_number, const uint8_t* port_path, int port_path_length) {
+        int index = indexOf(bus_number, port_path, port_path_length);
+        if (index >= 0) {
+            entries_.erase(entries_.begin() + index);
+            dirty_ = true;
+        }
+    }
+
+    bool dirty() const { return dirty_; }
+
+private:
+    int indexOf(uint8_t bus_number, const uint8_t* port_path, int port_path_length) const {
+        // A device with no port path can't be told apart from whatever else is on its bus
+        if (port_path_length <= 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < entries_.size(); i++) {
+            const DeviceCacheEntry& entry = entries_[i];
+            if (entry.bus_number == bus_number && entry.port_path_length == port_path_length &&
+                memcmp(entry.port_path, port_path, port_path_length) == 0) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    static bool same(const DeviceCacheEntry& a, const DeviceCacheEntry& b) {
+        return a.vendor_id == b.vendor_id && a.product_id == b.product_id &&
+               a.layout.hid_interface == b.layout.hid_interface &&
+               a.layout.interrupt_in_endpoint == b.layout.interrupt_in_endpoint &&
+               a.layout.in_packet_size == b.layout.in_packet_size &&
+               a.layout.interrupt_out_endpoint == b.layout.interrupt_out_endpoint &&
+               a.layout.out_packet_size == b.layout.out_packet_size &&
+               a.preferred_player == b.preferred_player && a.slot == b.slot;
+    }
+
+    static bool parse(char* line, DeviceCacheEntry* entry) {
+        char port_path[32];
+        unsigned int bus, vendor_id, product_id, hid_interface, in_endpoint, out_endpoint;
+        int in_size, out_size, preferred_player, slot;
+        if (sscanf(line, "pad %u %31s %x %x %u %x %d %x %d %d %d", &bus, port_path, &vendor_id, &product_id,
+                   &hid_interface, &in_endpoint, &in_size, &out_endpoint, &out_size, &preferred_player, &slot) != 11) {
+            return false;
+        }
+        if (bus > 0xFF || vendor_id > 0xFFFF || product_id > 0xFFFF || hid_interface > 0xFF ||
+            in_endpoint > 0xFF || !(in_endpoint & 0x80) || out_endpoint > 0xFF || (out_endpoint & 0x80) ||
+            in_size <= 0 || out_size < 0) {
+            return false;
+        }
+
+        char* cursor = port_path;
+        while (*cursor) {
+            char* end;
+            unsigned long port = strtoul(cursor, &end, 10);
+            if (end == cursor || port > 0xFF || entry->port_path_length == static_cast<int>(sizeof(entry->port_path)) ||
+                (*end != '.' && *end != '\0')) {
+                return false;
+            }
+            entry->port_path[entry->port_path_length++] = static_cast<uint8_t>(port);
+            cursor = *end ? end + 1 : end;
+        }
+
+        entry->bus_number = static_cast<uint8_t>(bus);
+        entry->vendor_id = static_cast<uint16_t>(vendor_id);
+        entry->product_id = static_cast<uint16_t>(product_id);
+        entry->layout.hid_interface = static_cast<uint8_t>(hid_interface);
+        entry->layout.interrupt_in_endpoint = static_cast<uint8_t>(in_endpoint);
+        entry->layout.in_packet_size = in_size;
+        entry->layout.interrupt_out_endpoint = static_cast<uint8_t>(out_endpoint);
+        entry->layout.out_packet_size = out_size;
+        entry->preferred_player = preferred_player;
+        entry->slot = slot;
+        return entry->port_path_length > 0;
+    }
+
+    std::vector<DeviceCacheEntry> entries_;
+    bool dirty_ = false;
+};
+
+#endif
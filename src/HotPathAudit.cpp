@@ -0,0 +1,268 @@
+#ifdef LLDGSDK_AUDIT
+
+#include "HotPathAudit.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <cerrno>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// How deep the current thread is in audited scopes. The malloc hooks read this, so it mustn't need
+// allocating itself on first use.
+#if defined(__GNUC__)
+static __thread int t_depth __attribute__((tls_model("initial-exec")));
+#else
+static thread_local int t_depth;
+#endif
+
+static std::atomic<uint64_t> g_reports{0};
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_lock_acquisitions{0};
+static std::atomic<uint64_t> g_syscalls{0};
+static std::atomic<uint64_t> g_notifies{0};
+
+static inline void count(std::atomic<uint64_t>& counter) {
+    if (t_depth > 0) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+HotPathAuditScope::HotPathAuditScope() {
+    t_depth++;
+}
+
+HotPathAuditScope::~HotPathAuditScope() {
+    t_depth--;
+}
+
+// A pause nests inside a scope, so it can't just clear the depth: scopes may be opened inside the pause
+HotPathAuditPause::HotPathAuditPause() {
+    t_depth -= 1 << 16;
+}
+
+HotPathAuditPause::~HotPathAuditPause() {
+    t_depth += 1 << 16;
+}
+
+HotPathAuditNotify::HotPathAuditNotify() {
+    count(g_notifies);
+    t_depth -= 1 << 16;
+}
+
+HotPathAuditNotify::~HotPathAuditNotify() {
+    t_depth += 1 << 16;
+}
+
+void hotPathAuditReport() {
+    count(g_reports);
+}
+
+HotPathAuditCounts hotPathAuditCounts() {
+    HotPathAuditCounts counts;
+    counts.reports = g_reports.load(std::memory_order_relaxed);
+    counts.allocations = g_allocations.load(std::memory_order_relaxed);
+    counts.lock_acquisitions = g_lock_acquisitions.load(std::memory_order_relaxed);
+    counts.syscalls = g_syscalls.load(std::memory_order_relaxed);
+    counts.notifies = g_notifies.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void hotPathAuditReset() {
+    g_reports = 0;
+    g_allocations = 0;
+    g_lock_acquisitions = 0;
+    g_syscalls = 0;
+    g_notifies = 0;
+}
+
+#if defined(__GLIBC__)
+
+// glibc lets a program replace these outright; operator new goes through malloc, so it's covered too
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* pointer);
+
+    void* malloc(size_t size) {
+        count(g_allocations);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count_, size_t size) {
+        count(g_allocations);
+        return __libc_calloc(count_, size);
+    }
+
+    void* realloc(void* pointer, size_t size) {
+        count(g_allocations);
+        return __libc_realloc(pointer, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) {
+        count(g_allocations);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) {
+        count(g_allocations);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size) {
+        count(g_allocations);
+        void* pointer = __libc_memalign(alignment, size);
+        if (!pointer) {
+            return ENOMEM;
+        }
+        *result = pointer;
+        return 0;
+    }
+
+    void free(void* pointer) {
+        __libc_free(pointer);
+    }
+}
+
+// Everything else forwards to the next definition, looked up on first use
+template <typename Function>
+static Function next(Function& cached, const char* name) {
+    if (!cached) {
+        cached = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    }
+    return cached;
+}
+
+extern "C" {
+    int pthread_mutex_lock(pthread_mutex_t* mutex) {
+        static int (*real)(pthread_mutex_t*);
+        count(g_lock_acquisitions);
+        return next(real, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+        static int (*real)(pthread_mutex_t*);
+        count(g_lock_acquisitions);
+        return next(real, "pthread_mutex_trylock")(mutex);
+    }
+
+    ssize_t read(int fd, void* buffer, size_t length) {
+        static ssize_t (*real)(int, void*, size_t);
+        count(g_syscalls);
+        return next(real, "read")(fd, buffer, length);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t length) {
+        static ssize_t (*real)(int, const void*, size_t);
+        count(g_syscalls);
+        return next(real, "write")(fd, buffer, length);
+    }
+
+    int ioctl(int fd, unsigned long request, ...) {
+        static int (*real)(int, unsigned long, ...);
+        va_list args;
+        va_start(args, request);
+        void* argument = va_arg(args, void*);
+        va_end(args);
+        count(g_syscalls);
+        return next(real, "ioctl")(fd, request, argument);
+    }
+
+    int poll(struct pollfd* fds, nfds_t count_, int timeout) {
+        static int (*real)(struct pollfd*, nfds_t, int);
+        count(g_syscalls);
+        return next(real, "poll")(fds, count_, timeout);
+    }
+
+    int epoll_wait(int epoll_fd, struct epoll_event* events, int max_events, int timeout) {
+        static int (*real)(int, struct epoll_event*, int, int);
+        count(g_syscalls);
+        return next(real, "epoll_wait")(epoll_fd, events, max_events, timeout);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+        static int (*real)(const struct timespec*, struct timespec*);
+        count(g_syscalls);
+        return next(real, "nanosleep")(duration, remaining);
+    }
+
+    int clock_nanosleep(clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining) {
+        static int (*real)(clockid_t, int, const struct timespec*, struct timespec*);
+        count(g_syscalls);
+        return next(real, "clock_nanosleep")(clock, flags, time, remaining);
+    }
+
+    int sched_yield() {
+        static int (*real)();
+        count(g_syscalls);
+        return next(real, "sched_yield")();
+    }
+
+    // libstdc++ reaches futex through this for atomic waits
+    long syscall(long number, ...) {
+        static long (*real)(long, ...);
+        va_list args;
+        va_start(args, number);
+        long a = va_arg(args, long), b = va_arg(args, long), c = va_arg(args, long);
+        long d = va_arg(args, long), e = va_arg(args, long), f = va_arg(args, long);
+        va_end(args);
+        count(g_syscalls);
+        return next(real, "syscall")(number, a, b, c, d, e, f);
+    }
+}
+
+#else
+
+// Without glibc's hooks only C++ allocations can be seen
+void* operator new(size_t size) {
+    count(g_allocations);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    count(g_allocations);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+#endif
+
+#endif
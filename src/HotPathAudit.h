@@ -0,0 +1,72 @@
+#ifndef LLDGSDK_HOTPATHAUDIT_H
+#define LLDGSDK_HOTPATHAUDIT_H
+
+#include <cstdint>
+
+// Audit builds (LLDGSDK_AUDIT, see the CMake option) count heap allocations, mutex acquisitions and
+// syscalls made by the SDK's own code on the USB thread: report handling and the event loop's housekeeping,
+// but not the transport's wait for completions or the user's callback. Allocations are counted through
+// operator new and, on glibc, malloc; locks and syscalls through the glibc entry points that take them, so
+// those two read 0 elsewhere. In normal builds the scopes below compile away.
+//
+// The one syscall the input path is allowed is the write that makes getInputFd() readable. It's only made
+// when the game has acknowledged the previous one, so its budget is one per acknowledgeInput() call (plus the
+// first, which needs none); it's counted in `notifies` rather than `syscalls` so the audit can hold it to that.
+
+struct HotPathAuditCounts {
+    uint64_t reports;
+    uint64_t allocations;
+    uint64_t lock_acquisitions;
+    uint64_t syscalls;
+    uint64_t notifies;
+};
+
+#ifdef LLDGSDK_AUDIT
+
+// Counts everything the current thread does while one of these is alive
+class HotPathAuditScope {
+public:
+    HotPathAuditScope();
+    ~HotPathAuditScope();
+};
+
+// Stops counting for a stretch of a scope that runs someone else's code
+class HotPathAuditPause {
+public:
+    HotPathAuditPause();
+    ~HotPathAuditPause();
+};
+
+// Counts one input fd wakeup, and stops counting for the write that makes it
+class HotPathAuditNotify {
+public:
+    HotPathAuditNotify();
+    ~HotPathAuditNotify();
+};
+
+void hotPathAuditReport();
+HotPathAuditCounts hotPathAuditCounts();
+void hotPathAuditReset();
+
+#else
+
+class HotPathAuditScope {
+public:
+    HotPathAuditScope() {}
+};
+
+class HotPathAuditPause {
+public:
+    HotPathAuditPause() {}
+};
+
+class HotPathAuditNotify {
+public:
+    HotPathAuditNotify() {}
+};
+
+inline void hotPathAuditReport() {}
+
+#endif
+
+#endif
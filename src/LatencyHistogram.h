@@ -0,0 +1,107 @@
+#ifndef LLDGSDK_LATENCYHISTOGRAM_H
+#define LLDGSDK_LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "lowlatencydancegamesdk.h"
+
+// Log-linear histogram of nanosecond durations: each power of two is split into 8 buckets, so any
+// reported percentile is within 12.5% of the true value. One thread records and any thread may read;
+// the recorder only does plain relaxed stores, so recording never waits on a reader.
+class LatencyHistogram {
+public:
+    void record(uint64_t value_ns) {
+        std::atomic<uint32_t>& bucket = buckets_[bucketFor(value_ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value_ns > max_.load(std::memory_order_relaxed)) {
+            max_.store(value_ns, std::memory_order_relaxed);
+        }
+    }
+
+    // Percentiles are taken from a snapshot that may be a few samples behind the recorder
+    LowLatencyDanceGameSDK::LatencySummary summarize() const {
+        uint32_t counts[k_bucket_count];
+        uint64_t total = 0;
+        for (int i = 0; i < k_bucket_count; i++) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        LowLatencyDanceGameSDK::LatencySummary summary = {};
+        summary.count = total;
+        summary.max_ns = max_.load(std::memory_order_relaxed);
+        if (total == 0) {
+            return summary;
+        }
+        summary.p50_ns = percentile(counts, total, 500);
+        summary.p99_ns = percentile(counts, total, 990);
+        summary.p999_ns = percentile(counts, total, 999);
+        return summary;
+    }
+
+    // Clears every sample. Readers racing it may see a mix of old and cleared buckets.
+    void reset() {
+        for (std::atomic<uint32_t>& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int k_sub_bits = 3;
+    static constexpr int k_sub_buckets = 1 << k_sub_bits;
+    static constexpr int k_bucket_count = (64 - k_sub_bits + 1) * k_sub_buckets;
+
+    static int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<int>(index);
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    static int bucketFor(uint64_t value) {
+        if (value < k_sub_buckets) {
+            return static_cast<int>(value);
+        }
+        int exponent = highestBit(value);
+        int sub = static_cast<int>(value >> (exponent - k_sub_bits)) & (k_sub_buckets - 1);
+        return (exponent - k_sub_bits + 1) * k_sub_buckets + sub;
+    }
+
+    // Largest value that lands in `bucket`, so percentiles never under-report
+    static uint64_t bucketUpperBound(int bucket) {
+        if (bucket < k_sub_buckets) {
+            return static_cast<uint64_t>(bucket);
+        }
+        int exponent = bucket / k_sub_buckets + k_sub_bits - 1;
+        uint64_t sub = static_cast<uint64_t>(bucket % k_sub_buckets);
+        uint64_t lower = (k_sub_buckets + sub) << (exponent - k_sub_bits);
+        return lower + (1ull << (exponent - k_sub_bits)) - 1;
+    }
+
+    uint64_t percentile(const uint32_t* counts, uint64_t total, uint64_t per_mille) const {
+        uint64_t rank = (total * per_mille + 999) / 1000;
+        uint64_t seen = 0;
+        for (int i = 0; i < k_bucket_count; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t bound = bucketUpperBound(i);
+                uint64_t max = max_.load(std::memory_order_relaxed);
+                return bound < max ? bound : max;
+            }
+        }
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    std::atomic<uint32_t> buckets_[k_bucket_count] = {};
+    std::atomic<uint64_t> max_{0};
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LLDGSDK_MONOTONICCLOCK_H
+#define LLDGSDK_MONOTONICCLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+// The clock every SDK timestamp is taken on (CLOCK_MONOTONIC on Linux)
+inline uint64_t monotonicNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
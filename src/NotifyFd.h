@@ -0,0 +1,83 @@
+#ifndef LLDGSDK_NOTIFYFD_H
+#define LLDGSDK_NOTIFYFD_H
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+
+// A descriptor another thread can poll on, made readable by signal() and drained by clear(). An eventfd on
+// Linux and a non-blocking pipe on other POSIX systems; Windows has no equivalent, so fd() is -1 there.
+class NotifyFd {
+public:
+    ~NotifyFd() { close(); }
+
+    bool open() {
+        if (read_fd_ >= 0) {
+            return true;
+        }
+#if defined(__linux__)
+        read_fd_ = write_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+        int fds[2];
+        if (pipe(fds) == 0) {
+            for (int fd : fds) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+            read_fd_ = fds[0];
+            write_fd_ = fds[1];
+        }
+#endif
+        return read_fd_ >= 0;
+    }
+
+    void close() {
+#if !defined(_WIN32)
+        if (read_fd_ >= 0) {
+            ::close(read_fd_);
+        }
+        if (write_fd_ >= 0 && write_fd_ != read_fd_) {
+            ::close(write_fd_);
+        }
+#endif
+        read_fd_ = write_fd_ = -1;
+    }
+
+    int fd() const { return read_fd_; }
+
+    // A full pipe or counter is already readable, so a failed write loses nothing
+    void signal() {
+#if defined(__linux__)
+        uint64_t one = 1;
+        ssize_t ignored = write(write_fd_, &one, sizeof(one));
+        (void)ignored;
+#elif !defined(_WIN32)
+        char byte = 1;
+        ssize_t ignored = write(write_fd_, &byte, 1);
+        (void)ignored;
+#endif
+    }
+
+    void clear() {
+#if defined(__linux__)
+        uint64_t count;
+        ssize_t ignored = read(read_fd_, &count, sizeof(count));
+        (void)ignored;
+#elif !defined(_WIN32)
+        char buffer[64];
+        while (read(read_fd_, buffer, sizeof(buffer)) > 0) {
+        }
+#endif
+    }
+
+private:
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+};
+
+#endif
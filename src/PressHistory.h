@@ -0,0 +1,94 @@
+#ifndef LLDGSDK_PRESSHISTORY_H
+#define LLDGSDK_PRESSHISTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// The last `Length` presses of each of a pad's 16 panels, with when each was pressed and released. One
+// writer (the USB thread) records state changes; any number of readers can query at once, and a query
+// does a fixed amount of work whatever the writer is doing, so it's wait-free. Each entry carries the
+// number of the press in it, which a reader checks before and after copying the entry; an entry the
+// writer is overwriting mid-copy is skipped rather than retried, and since it can only be overwritten by
+// a newer press, so is everything older.
+template <size_t Length>
+class PressHistory {
+    static_assert(Length >= 2 && (Length & (Length - 1)) == 0, "Length must be a power of two");
+
+public:
+    static constexpr int PANELS = 16;
+
+    struct Press {
+        uint64_t press_ns;
+        uint64_t release_ns; // 0 while held
+    };
+
+    // Writer side: records the panels that changed between `previous` and `state`
+    void record(uint16_t previous, uint16_t state, uint64_t now_ns) {
+        uint16_t changed = static_cast<uint16_t>(previous ^ state);
+        for (int panel = 0; changed; panel++, changed >>= 1) {
+            if (!(changed & 1)) {
+                continue;
+            }
+            Panel& history = panels_[panel];
+            uint32_t count = history.count.load(std::memory_order_relaxed);
+            if (state & (1u << panel)) {
+                size_t index = count & (Length - 1);
+                history.version[index].store(0, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                history.press_ns[index].store(now_ns, std::memory_order_relaxed);
+                history.release_ns[index].store(0, std::memory_order_relaxed);
+                history.version[index].store(count + 1, std::memory_order_release);
+                history.count.store(count + 1, std::memory_order_release);
+            } else if (count > 0) {
+                history.release_ns[(count - 1) & (Length - 1)].store(now_ns, std::memory_order_release);
+            }
+        }
+    }
+
+    // Reader side: copies up to Length of `panel`'s presses into `out`, newest first, and returns how many
+    size_t copy(int panel, Press* out, size_t max_presses = Length) const {
+        const Panel& history = panels_[panel];
+        uint32_t count = history.count.load(std::memory_order_acquire);
+        size_t copied = 0;
+        for (uint32_t press = count; press > 0 && count - press < Length && copied < max_presses; press--) {
+            size_t index = (press - 1) & (Length - 1);
+            uint32_t version = history.version[index].load(std::memory_order_acquire);
+            Press entry = {
+                history.press_ns[index].load(std::memory_order_relaxed),
+                history.release_ns[index].load(std::memory_order_relaxed),
+            };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version != press || history.version[index].load(std::memory_order_relaxed) != version) {
+                break;
+            }
+            out[copied++] = entry;
+        }
+        return copied;
+    }
+
+    // Forgets every press. Not safe against a concurrent record(); a concurrent copy() may see some entries
+    // cleared and others not, but never reads outside the history.
+    void reset() {
+        for (Panel& history : panels_) {
+            history.count.store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i < Length; i++) {
+                history.version[i].store(0, std::memory_order_relaxed);
+                history.press_ns[i].store(0, std::memory_order_relaxed);
+                history.release_ns[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    // Split into arrays rather than an array of entries, so a panel's history packs into whole cache lines
+    struct Panel {
+        std::atomic<uint64_t> press_ns[Length] = {};
+        std::atomic<uint64_t> release_ns[Length] = {};
+        std::atomic<uint32_t> version[Length] = {}; // Number of the press in each entry, counting from 1; 0 while written
+        std::atomic<uint32_t> count{0};             // Presses so far
+    };
+    Panel panels_[PANELS];
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef LLDGSDK_SPSCQUEUE_H
+#define LLDGSDK_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer/single-consumer ring. The producer (USB thread) and consumer (game thread)
+// each own one index, so neither side ever takes a lock or waits on the other.
+template <typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side. Returns false (and drops `item`) if the consumer has fallen a full ring behind.
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ == Capacity) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ == Capacity) {
+                return false;
+            }
+        }
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Copies up to `max_items` of the oldest entries into `out`, returns how many were copied.
+    size_t popInto(T* out, size_t max_items) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t available = head_.load(std::memory_order_acquire) - tail;
+        size_t count = (available < max_items) ? available : max_items;
+        for (size_t i = 0; i < count; i++) {
+            out[i] = items_[(tail + i) & (Capacity - 1)];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Empties the queue. Only while neither side is using it, e.g. between sessions.
+    void reset() {
+        head_.store(0, std::memory_order_relaxed);
+        cached_tail_ = 0;
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0; // producer-private copy of tail_
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T items_[Capacity];
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef LLDGSDK_SEQLOCKLATCH_H
+#define LLDGSDK_SEQLOCKLATCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// A table of `Count` entries that one writer updates an entry at a time and any number of readers copy
+// whole, always seeing every entry as of the same instant. It's a seqlock with two copies of the table
+// (a "latch"): the sequence number says which copy is stable, and the writer only ever touches the
+// other one, so a reader never waits for a write to finish. A reader only copies again if an update
+// landed while it was copying. Entries are stored as relaxed atomic words, so racing reads are defined.
+template <typename T, size_t Count>
+class SeqlockLatch {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqlockLatch entries are copied bytewise");
+    static constexpr size_t k_words = (sizeof(T) + 7) / 8;
+
+public:
+    // Writer side
+    void publish(size_t index, const T& entry) {
+        uint64_t words[k_words] = {};
+        memcpy(words, &entry, sizeof(T));
+
+        // Readers move to copy 1 while copy 0 is updated, then back to copy 0 while copy 1 catches up
+        uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(copies_[0][index], words);
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence_.store(sequence + 2, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(copies_[1][index], words);
+    }
+
+    // Reader side: copies the whole table into `out` and returns the number of updates it reflects
+    uint64_t read(T* out) const {
+        uint64_t words[Count][k_words];
+        while (true) {
+            uint64_t sequence = sequence_.load(std::memory_order_acquire);
+            const Word (&copy)[Count][k_words] = copies_[sequence & 1];
+            for (size_t i = 0; i < Count; i++) {
+                for (size_t word = 0; word < k_words; word++) {
+                    words[i][word] = copy[i][word].load(std::memory_order_relaxed);
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == sequence) {
+                for (size_t i = 0; i < Count; i++) {
+                    memcpy(&out[i], words[i], sizeof(T));
+                }
+                return sequence / 2;
+            }
+        }
+    }
+
+private:
+    using Word = std::atomic<uint64_t>;
+
+    static void store(Word (&entry)[k_words], const uint64_t* words) {
+        for (size_t word = 0; word < k_words; word++) {
+            entry[word].store(words[word], std::memory_order_relaxed);
+        }
+    }
+
+    alignas(64) std::atomic<uint64_t> sequence_{0};
+    Word copies_[2][Count][k_words] = {};
+};
+
+#endif
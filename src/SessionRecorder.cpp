@@ -0,0 +1,218 @@
+#include "SessionRecorder.h"
+#include "MonotonicClock.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// How far ahead of the writer the file is extended and mapped
+static const size_t k_map_step = 4 << 20;
+
+static size_t paddedSize(size_t payload_length) {
+    return (sizeof(RecordingRecordHeader) + payload_length + 7) & ~static_cast<size_t>(7);
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const char* path) {
+    RecordingFileHeader header = {};
+    memcpy(header.magic, k_recording_magic, sizeof(header.magic));
+    header.version = k_recording_version;
+    header.header_size = sizeof(header);
+    header.start_ns = monotonicNanoseconds();
+    header.start_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+#ifdef _WIN32
+    file_ = fopen(path, "wb");
+    if (!file_) {
+        return false;
+    }
+#else
+    fd_ = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+#endif
+    write_offset_ = 0;
+    failed_ = false;
+    if (!reserve(sizeof(header))) {
+        stop();
+        return false;
+    }
+#ifdef _WIN32
+    fwrite(&header, sizeof(header), 1, file_);
+#else
+    memcpy(map_, &header, sizeof(header));
+#endif
+    write_offset_ = sizeof(header);
+
+    dropped_ = 0;
+    written_dropped_ = 0;
+    stopping_ = false;
+    writer_ = std::thread(&SessionRecorder::writerLoop, this);
+    return true;
+}
+
+void SessionRecorder::stop() {
+    if (writer_.joinable()) {
+        stopping_.store(true, std::memory_order_release);
+        writer_.join();
+    }
+
+#ifdef _WIN32
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+#else
+    if (map_) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        // Drop the zero-filled space that was mapped ahead of the writer
+        if (ftruncate(fd_, static_cast<off_t>(write_offset_)) != 0) {
+            // The zero-sized record after the last one still ends the file
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+void SessionRecorder::recordReport(int player, const uint8_t* report, int length, uint16_t state, uint64_t timestamp_ns) {
+    int stored = length < k_recording_max_payload ? length : k_recording_max_payload;
+    while (stored > 0 && report[stored - 1] == 0) {
+        stored--;
+    }
+    stage(RecordingRecordType::Report, player, state, report, stored, length, timestamp_ns);
+}
+
+void SessionRecorder::recordRelease(int player, uint16_t state, uint64_t timestamp_ns) {
+    stage(RecordingRecordType::Release, player, state, nullptr, 0, 0, timestamp_ns);
+}
+
+void SessionRecorder::recordAttach(int player, const RecordingAttach& attach, const uint8_t* descriptor, uint64_t timestamp_ns) {
+    stage(RecordingRecordType::Attach, player, 0, reinterpret_cast<const uint8_t*>(&attach), sizeof(attach),
+          sizeof(attach), timestamp_ns);
+    for (int offset = 0; offset < attach.descriptor_length; offset += k_recording_max_payload) {
+        int length = attach.descriptor_length - offset;
+        if (length > k_recording_max_payload) {
+            length = k_recording_max_payload;
+        }
+        stage(RecordingRecordType::Descriptor, player, 0, &descriptor[offset], length, length, timestamp_ns);
+    }
+}
+
+void SessionRecorder::recordDetach(int player, uint64_t timestamp_ns) {
+    stage(RecordingRecordType::Detach, player, 0, nullptr, 0, 0, timestamp_ns);
+}
+
+void SessionRecorder::stage(RecordingRecordType type, int player, uint16_t state, const uint8_t* payload, int length,
+                            int original_length, uint64_t timestamp_ns) {
+    Staged staged;
+    memset(&staged.header, 0, sizeof(staged.header));
+    staged.header.timestamp_ns = timestamp_ns;
+    staged.header.size = static_cast<uint16_t>(paddedSize(length));
+    staged.header.type = static_cast<uint8_t>(type);
+    staged.header.player = static_cast<uint8_t>(player);
+    staged.header.state = state;
+    staged.header.length = static_cast<uint16_t>(length);
+    staged.header.original_length = static_cast<uint16_t>(original_length);
+    if (length > 0) {
+        memcpy(staged.payload, payload, length);
+    }
+    if (!staging_.push(staged)) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void SessionRecorder::writerLoop() {
+    while (true) {
+        // Read before draining, so nothing staged before stop() can be left behind
+        bool stopping = stopping_.load(std::memory_order_acquire);
+        size_t count = staging_.popInto(batch_, k_batch);
+        for (size_t i = 0; i < count; i++) {
+            append(batch_[i].header, batch_[i].payload);
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != written_dropped_) {
+            uint64_t lost = dropped - written_dropped_;
+            written_dropped_ = dropped;
+            RecordingRecordHeader gap = {};
+            gap.timestamp_ns = monotonicNanoseconds();
+            gap.size = static_cast<uint16_t>(paddedSize(sizeof(lost)));
+            gap.type = static_cast<uint8_t>(RecordingRecordType::Gap);
+            gap.length = sizeof(lost);
+            gap.original_length = sizeof(lost);
+            append(gap, reinterpret_cast<const uint8_t*>(&lost));
+        }
+
+        if (count == 0) {
+            if (stopping) {
+                return;
+            }
+            // Polled rather than signalled, so staging a record never costs the USB thread a syscall
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+}
+
+void SessionRecorder::append(const RecordingRecordHeader& header, const uint8_t* payload) {
+    size_t size = header.size;
+    if (failed_ || !reserve(size)) {
+        failed_ = true;
+        return;
+    }
+#ifdef _WIN32
+    static const uint8_t padding[8] = {0};
+    size_t written = sizeof(header) + header.length;
+    fwrite(&header, sizeof(header), 1, file_);
+    fwrite(payload, 1, header.length, file_);
+    fwrite(padding, 1, size - written, file_);
+#else
+    uint8_t* destination = map_ + (write_offset_ - map_offset_);
+    memcpy(destination, &header, sizeof(header));
+    memcpy(destination + sizeof(header), payload, header.length);
+    // The rest of the record is already zero: the file is extended with zeros and never rewritten
+#endif
+    write_offset_ += size;
+}
+
+// Makes sure the next `bytes` after write_offset_ are mapped, moving the mapping along if they aren't
+bool SessionRecorder::reserve(size_t bytes) {
+#ifdef _WIN32
+    (void)bytes;
+    return file_ != nullptr;
+#else
+    if (map_ && write_offset_ + bytes <= map_offset_ + map_size_) {
+        return true;
+    }
+    if (map_) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    map_offset_ = write_offset_ & ~(page - 1);
+    map_size_ = k_map_step;
+    if (ftruncate(fd_, static_cast<off_t>(map_offset_ + map_size_)) != 0) {
+        return false;
+    }
+    void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(map_offset_));
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+    return true;
+#endif
+}
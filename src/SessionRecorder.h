@@ -0,0 +1,69 @@
+#ifndef LLDGSDK_SESSIONRECORDER_H
+#define LLDGSDK_SESSIONRECORDER_H
+
+#include "SessionRecordingFormat.h"
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+// Captures a session to a recording file (see SessionRecordingFormat.h). The record* calls only copy the
+// record into a lock-free staging ring, so the USB thread never waits on the disk; a writer thread of the
+// recorder's own drains the ring into the file through a memory mapping that's extended a few megabytes
+// at a time. If the writer falls a whole ring behind, records are dropped and counted in a Gap record.
+//
+// The record* calls are the ring's producer side: one thread at a time, which is the USB thread while
+// it runs and whichever thread owns the devices otherwise. Windows has no mapping here and writes through
+// stdio instead.
+class SessionRecorder {
+public:
+    ~SessionRecorder();
+
+    // Replaces any file at `path`
+    bool start(const char* path);
+    // Writes out everything staged and closes the file
+    void stop();
+
+    void recordReport(int player, const uint8_t* report, int length, uint16_t state, uint64_t timestamp_ns);
+    void recordRelease(int player, uint16_t state, uint64_t timestamp_ns);
+    void recordAttach(int player, const RecordingAttach& attach, const uint8_t* descriptor, uint64_t timestamp_ns);
+    void recordDetach(int player, uint64_t timestamp_ns);
+
+private:
+    struct Staged {
+        RecordingRecordHeader header;
+        uint8_t payload[k_recording_max_payload];
+    };
+    static const size_t k_staging_capacity = 8192;
+    static const size_t k_batch = 256;
+
+    void stage(RecordingRecordType type, int player, uint16_t state, const uint8_t* payload, int length,
+               int original_length, uint64_t timestamp_ns);
+    void writerLoop();
+    void append(const RecordingRecordHeader& header, const uint8_t* payload);
+    bool reserve(size_t bytes);
+
+    SPSCQueue<Staged, k_staging_capacity> staging_;
+    std::atomic<uint64_t> dropped_{0};
+
+    // Writer thread only, apart from start() and stop()
+    std::thread writer_;
+    std::atomic<bool> stopping_{false};
+    Staged batch_[k_batch];
+    uint64_t written_dropped_ = 0;
+    bool failed_ = false; // The disk filled up or the file went away; nothing more is written
+#ifdef _WIN32
+    FILE* file_ = nullptr;
+#else
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t map_offset_ = 0; // File offset the mapping starts at
+    size_t map_size_ = 0;
+#endif
+    size_t write_offset_ = 0;
+};
+
+#endif
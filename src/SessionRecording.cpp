@@ -0,0 +1,281 @@
+#include "lowlatencydancegamesdk_recording.h"
+#include "SessionRecordingFormat.h"
+#include "DebounceFilter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+    #include "adapters/AdapterBase.h"
+    #include "adapters/AdapterLayout.h"
+    #include "adapters/HIDPad/HIDPadAdapter.h"
+}
+
+// What replay() knows about the pad in one player slot
+struct ReplayPad {
+    struct DancePadAdapter adapter = {};
+    std::unique_ptr<DancePadAdapterLayout> hid_layout;
+    std::vector<uint8_t> descriptor;
+    size_t descriptor_length = 0;
+    DebounceFilter debounce;
+    uint16_t state = 0;
+};
+
+struct LowLatencyDanceGameRecording::Impl {
+    // The whole file, mapped read-only (read into `contents` on Windows)
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> contents;
+#endif
+    RecordingFileHeader header = {};
+    size_t cursor = 0;
+
+    void unmap() {
+#ifdef _WIN32
+        contents.clear();
+        contents.shrink_to_fit();
+#else
+        if (data && size > 0) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        cursor = 0;
+    }
+
+    static void notify(ReplayPad& pad, int player, uint16_t state, uint64_t timestamp_ns, ReplayResult& result,
+                       ReplayCallback callback, void* user_data) {
+        if (state == pad.state) {
+            return;
+        }
+        pad.state = state;
+        result.transitions++;
+        if (callback) {
+            callback(player, state, timestamp_ns, user_data);
+        }
+    }
+
+    // A pad with no adapter of its own is read by its report descriptor, as the SDK did when it attached it
+    static void buildHIDAdapter(ReplayPad& pad, uint16_t vendor_id, uint16_t product_id) {
+        std::unique_ptr<DancePadAdapterLayout> layout(new DancePadAdapterLayout());
+        if (hid_pad_build_layout(pad.descriptor.data(), static_cast<int>(pad.descriptor.size()), layout.get())) {
+            pad.adapter = hid_pad_adapter(vendor_id, product_id, layout.get());
+            pad.hid_layout = std::move(layout);
+        }
+    }
+
+    // The same steps as the SDK's handleReport(), minus command responses
+    static uint16_t decode(ReplayPad& pad, uint8_t* report, int length, uint64_t timestamp_ns) {
+        if (pad.adapter.classify_report) {
+            const uint8_t* payload = nullptr;
+            int payload_length = 0;
+            if (!(pad.adapter.classify_report(report, length, &payload, &payload_length) & DancePadAdapterReportInput)) {
+                return pad.state;
+            }
+        }
+        if (pad.adapter.layout && !dance_pad_layout_matches(pad.adapter.layout, report, length)) {
+            return pad.state;
+        }
+        return pad.debounce.filter(dance_pad_adapter_convert(&pad.adapter, report, length), timestamp_ns);
+    }
+};
+
+LowLatencyDanceGameRecording::LowLatencyDanceGameRecording() : pImpl(new Impl()) {
+}
+
+LowLatencyDanceGameRecording::~LowLatencyDanceGameRecording() {
+    close();
+}
+
+bool LowLatencyDanceGameRecording::open(const char* path) {
+    close();
+
+#ifdef _WIN32
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        pImpl->contents.insert(pImpl->contents.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    pImpl->data = pImpl->contents.data();
+    pImpl->size = pImpl->contents.size();
+#else
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(RecordingFileHeader))) {
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    pImpl->data = static_cast<const uint8_t*>(map);
+    pImpl->size = static_cast<size_t>(info.st_size);
+#endif
+
+    if (pImpl->size < sizeof(RecordingFileHeader)) {
+        pImpl->unmap();
+        return false;
+    }
+    memcpy(&pImpl->header, pImpl->data, sizeof(pImpl->header));
+    if (memcmp(pImpl->header.magic, k_recording_magic, sizeof(k_recording_magic)) != 0 ||
+        pImpl->header.version != k_recording_version || pImpl->header.header_size < sizeof(RecordingFileHeader) ||
+        pImpl->header.header_size > pImpl->size) {
+        pImpl->unmap();
+        return false;
+    }
+    pImpl->cursor = pImpl->header.header_size;
+    return true;
+}
+
+void LowLatencyDanceGameRecording::close() {
+    pImpl->unmap();
+    pImpl->header = RecordingFileHeader();
+}
+
+uint64_t LowLatencyDanceGameRecording::getStartTime() {
+    return pImpl->header.start_ns;
+}
+
+uint64_t LowLatencyDanceGameRecording::getStartUnixTime() {
+    return pImpl->header.start_unix_ns;
+}
+
+bool LowLatencyDanceGameRecording::next(Record& record) {
+    if (!pImpl->data || pImpl->cursor + sizeof(RecordingRecordHeader) > pImpl->size) {
+        return false;
+    }
+    RecordingRecordHeader header;
+    memcpy(&header, pImpl->data + pImpl->cursor, sizeof(header));
+    if (header.size == 0) {
+        return false;
+    }
+    // A record that doesn't fit is one the writer never finished
+    if (header.size < sizeof(header) + header.length || header.length > k_recording_max_payload ||
+        pImpl->cursor + header.size > pImpl->size) {
+        return false;
+    }
+    const uint8_t* payload = pImpl->data + pImpl->cursor + sizeof(header);
+
+    memset(&record, 0, sizeof(record));
+    record.type = static_cast<RecordType>(header.type);
+    record.player = header.player;
+    record.timestamp_ns = header.timestamp_ns;
+    record.button_state = header.state;
+    switch (static_cast<RecordingRecordType>(header.type)) {
+        case RecordingRecordType::Report:
+            // Trailing zeros were dropped; they're already back, since `data` starts zeroed
+            memcpy(record.data, payload, header.length);
+            record.original_length = header.original_length;
+            record.length = header.original_length < MAX_DATA_SIZE ? header.original_length : MAX_DATA_SIZE;
+            break;
+        case RecordingRecordType::Descriptor:
+            memcpy(record.data, payload, header.length);
+            record.length = header.length;
+            record.original_length = header.length;
+            break;
+        case RecordingRecordType::Attach: {
+            RecordingAttach attach = {};
+            memcpy(&attach, payload, header.length < sizeof(attach) ? header.length : sizeof(attach));
+            record.vendor_id = attach.vendor_id;
+            record.product_id = attach.product_id;
+            record.release_hold_us = attach.release_hold_us;
+            record.descriptor_length = attach.descriptor_length;
+            record.bus_number = attach.bus_number;
+            record.port_path_length = attach.port_path_length <= sizeof(attach.port_path) ? attach.port_path_length : 0;
+            memcpy(record.port_path, attach.port_path, sizeof(record.port_path));
+            break;
+        }
+        case RecordingRecordType::Gap:
+            memcpy(&record.lost, payload, header.length < sizeof(record.lost) ? header.length : sizeof(record.lost));
+            break;
+        default:
+            break;
+    }
+    pImpl->cursor += header.size;
+    return true;
+}
+
+void LowLatencyDanceGameRecording::rewind() {
+    pImpl->cursor = pImpl->data ? pImpl->header.header_size : 0;
+}
+
+LowLatencyDanceGameRecording::ReplayResult LowLatencyDanceGameRecording::replay(ReplayCallback callback, void* user_data) {
+    ReplayResult result = {};
+    std::vector<ReplayPad> pads(256);
+    std::vector<uint16_t> vendor_ids(256), product_ids(256);
+
+    rewind();
+    Record record;
+    while (next(record)) {
+        ReplayPad& pad = pads[record.player];
+        switch (record.type) {
+            case RecordType::Attach:
+                pad.adapter = dance_pad_adapter_for(record.vendor_id, record.product_id);
+                pad.hid_layout.reset();
+                pad.descriptor.clear();
+                pad.descriptor_length = record.descriptor_length;
+                vendor_ids[record.player] = record.vendor_id;
+                product_ids[record.player] = record.product_id;
+                // The SDK configures the filter from the adapter it had, which may not be the one registered here
+                pad.debounce.configure(static_cast<uint64_t>(record.release_hold_us) * 1000);
+                Impl::notify(pad, record.player, 0, record.timestamp_ns, result, callback, user_data);
+                break;
+            case RecordType::Descriptor:
+                pad.descriptor.insert(pad.descriptor.end(), record.data, record.data + record.length);
+                if (!pad.adapter.is_valid && pad.descriptor.size() >= pad.descriptor_length) {
+                    Impl::buildHIDAdapter(pad, vendor_ids[record.player], product_ids[record.player]);
+                }
+                break;
+            case RecordType::Report: {
+                result.reports++;
+                if (!pad.adapter.is_valid) {
+                    result.undecodable++;
+                    break;
+                }
+                uint16_t state = Impl::decode(pad, record.data, static_cast<int>(record.length), record.timestamp_ns);
+                if (state != record.button_state) {
+                    result.mismatches++;
+                }
+                Impl::notify(pad, record.player, state, record.timestamp_ns, result, callback, user_data);
+                break;
+            }
+            case RecordType::Release: {
+                uint16_t state = pad.debounce.expire(record.timestamp_ns);
+                if (state != record.button_state) {
+                    result.mismatches++;
+                }
+                Impl::notify(pad, record.player, state, record.timestamp_ns, result, callback, user_data);
+                break;
+            }
+            case RecordType::Detach:
+                pad.debounce.reset();
+                Impl::notify(pad, record.player, 0, record.timestamp_ns, result, callback, user_data);
+                pad.adapter = DancePadAdapter();
+                break;
+            case RecordType::Gap:
+                result.lost += record.lost;
+                break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,65 @@
+#ifndef LLDGSDK_SESSIONRECORDINGFORMAT_H
+#define LLDGSDK_SESSIONRECORDINGFORMAT_H
+
+#include <cstdint>
+
+// Session recording files, as written by SessionRecorder and read by LowLatencyDanceGameRecording. All
+// integers are little-endian.
+//
+// The file is a RecordingFileHeader followed by records, each a RecordingRecordHeader and `length`
+// payload bytes, padded so the next record starts on an 8-byte boundary. The file only ever grows; it's
+// extended in large zero-filled steps ahead of the writer, so a record whose `size` is 0 marks the end of
+// what was written, which is also where a recording cut short by a crash ends.
+//
+// Report payloads are stored with trailing zero bytes dropped, since most pads pad short reports out to
+// the packet size; `original_length` says how long the report really was.
+
+static const char k_recording_magic[8] = {'L', 'L', 'D', 'G', 'R', 'E', 'C', '1'};
+static const uint32_t k_recording_version = 1;
+
+struct RecordingFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;      // Where the first record starts
+    uint64_t start_ns;         // Monotonic clock when recording began
+    uint64_t start_unix_ns;    // Wall clock at the same moment, for matching a recording to a complaint
+    uint8_t reserved[32];
+};
+static_assert(sizeof(RecordingFileHeader) == 64, "RecordingFileHeader layout");
+
+enum class RecordingRecordType : uint8_t {
+    Report = 1,     // A report from the pad: payload is its bytes, `state` what the SDK published after it
+    Release = 2,    // A held-back release expiring with no report: `state` is the new state
+    Attach = 3,     // A pad took `player`'s slot: payload is a RecordingAttach
+    Detach = 4,     // The pad in `player`'s slot went away
+    Descriptor = 5, // Part of an attached HID pad's report descriptor, in order, right after its Attach
+    Gap = 6,        // The staging buffer overflowed: payload is the uint64_t count of records lost
+};
+
+struct RecordingRecordHeader {
+    uint64_t timestamp_ns;    // Monotonic clock
+    uint16_t size;            // Whole record including padding; 0 ends the file
+    uint8_t type;             // RecordingRecordType
+    uint8_t player;
+    uint16_t state;
+    uint16_t length;          // Payload bytes stored
+    uint16_t original_length; // Payload bytes before trailing zeros were dropped
+    uint8_t reserved[6];
+};
+static_assert(sizeof(RecordingRecordHeader) == 24, "RecordingRecordHeader layout");
+
+struct RecordingAttach {
+    uint16_t vendor_id;
+    uint16_t product_id;
+    uint32_t release_hold_us;
+    uint16_t descriptor_length; // Bytes of report descriptor in the Descriptor records that follow
+    uint8_t bus_number;
+    uint8_t port_path_length;
+    uint8_t port_path[8];
+};
+static_assert(sizeof(RecordingAttach) == 20, "RecordingAttach layout");
+
+// Most payload bytes one record carries; longer reports are cut short, keeping original_length
+static const int k_recording_max_payload = 64;
+
+#endif
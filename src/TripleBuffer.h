@@ -0,0 +1,51 @@
+#ifndef LLDGSDK_TRIPLEBUFFER_H
+#define LLDGSDK_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free latest-value exchange between one writer and one reader. The writer fills a private back
+// buffer and publishes it; the reader picks up whatever was published most recently. Anything published
+// in between is overwritten, which is what we want for data where only the newest value matters.
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side: fill writeBuffer(), then publish() it
+    T& writeBuffer() { return buffers_[write_index_]; }
+
+    void publish() {
+        uint8_t previous = shared_.exchange(static_cast<uint8_t>(write_index_ | k_fresh), std::memory_order_acq_rel);
+        write_index_ = previous & k_index_mask;
+    }
+
+    // Reader side: returns the newest published value if it hasn't been taken yet, otherwise nullptr.
+    // The returned value stays valid until the next call.
+    const T* consume() {
+        if (!hasFresh()) {
+            return nullptr;
+        }
+        uint8_t previous = shared_.exchange(read_index_, std::memory_order_acq_rel);
+        read_index_ = previous & k_index_mask;
+        return &buffers_[read_index_];
+    }
+
+    bool hasFresh() const { return (shared_.load(std::memory_order_acquire) & k_fresh) != 0; }
+
+    // Drops anything published and not yet taken. Only while neither side is using it, e.g. between sessions.
+    void reset() {
+        write_index_ = 0;
+        shared_.store(1, std::memory_order_relaxed);
+        read_index_ = 2;
+    }
+
+private:
+    static constexpr uint8_t k_index_mask = 0x03;
+    static constexpr uint8_t k_fresh = 0x04;
+
+    T buffers_[3];
+    uint8_t write_index_ = 0;
+    std::atomic<uint8_t> shared_{1};
+    uint8_t read_index_ = 2;
+};
+
+#endif
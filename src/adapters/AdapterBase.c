@@ -1,23 +1,91 @@
 #include "AdapterBase.h"
 #include "SMXStage/SMXStageAdapter.h"
 #include "FoamPad/FoamPadAdapter.h"
+#include <string.h>
 
-extern struct DancePadAdapter dance_pad_adapter_for(uint16_t vendor_id, uint16_t product_id) {
-    static bool adapters_initialized = false;
-    static struct DancePadAdapter adapters[2];
-    if (!adapters_initialized) {
-        adapters[0] = default_smx_adapter();
-        adapters[1] = default_foam_pad_adapter();
-        adapters_initialized = true;
-    }
-    
-    for (int i = 0; i < sizeof(adapters); i++) {
-        if (vendor_id == adapters[i].vendor_id && product_id == adapters[i].product_id) {
-            return adapters[i];
+// Open-addressed hash table of adapters keyed by VID/PID, so lookups stay constant-time however many
+// pads are registered
+#define DANCE_PAD_REGISTRY_CAPACITY 1024
+
+struct DancePadAdapterRegistryEntry {
+    bool used;
+    uint32_t key;
+    struct DancePadAdapter adapter;
+};
+
+static struct DancePadAdapterRegistryEntry registry[DANCE_PAD_REGISTRY_CAPACITY];
+static int registry_count = 0;
+static bool registry_initialized = false;
+
+static uint32_t registry_key(uint16_t vendor_id, uint16_t product_id) {
+    return ((uint32_t)vendor_id << 16) | product_id;
+}
+
+static uint32_t registry_slot(uint32_t key) {
+    return (key * 2654435761u) >> 22; // Fibonacci hashing down to 10 bits
+}
+
+static struct DancePadAdapterRegistryEntry *registry_find(uint32_t key) {
+    uint32_t slot = registry_slot(key);
+    for (int probes = 0; probes < DANCE_PAD_REGISTRY_CAPACITY; probes++) {
+        struct DancePadAdapterRegistryEntry *entry = &registry[slot];
+        if (!entry->used || entry->key == key) {
+            return entry;
         }
+        slot = (slot + 1) & (DANCE_PAD_REGISTRY_CAPACITY - 1);
+    }
+    return NULL;
+}
+
+static bool registry_insert(const struct DancePadAdapter *adapter) {
+    uint32_t key = registry_key(adapter->vendor_id, adapter->product_id);
+    struct DancePadAdapterRegistryEntry *entry = registry_find(key);
+    if (entry == NULL) {
+        return false;
+    }
+    // Keep the table at most 3/4 full so probe sequences stay short
+    if (!entry->used && registry_count >= DANCE_PAD_REGISTRY_CAPACITY * 3 / 4) {
+        return false;
+    }
+    if (!entry->used) {
+        registry_count++;
+    }
+    entry->used = true;
+    entry->key = key;
+    entry->adapter = *adapter;
+    return true;
+}
+
+static void registry_initialize(void) {
+    if (registry_initialized) {
+        return;
+    }
+    registry_initialized = true;
+
+    struct DancePadAdapter smx = default_smx_adapter();
+    struct DancePadAdapter foam = default_foam_pad_adapter();
+    registry_insert(&smx);
+    registry_insert(&foam);
+}
+
+extern bool dance_pad_adapter_register(const struct DancePadAdapter *adapter) {
+    registry_initialize();
+    if (!adapter->is_valid || (adapter->input_converter == NULL && adapter->layout == NULL) || adapter->get_player == NULL) {
+        return false;
+    }
+    return registry_insert(adapter);
+}
+
+extern struct DancePadAdapter dance_pad_adapter_for(uint16_t vendor_id, uint16_t product_id) {
+    registry_initialize();
+
+    struct DancePadAdapterRegistryEntry *entry = registry_find(registry_key(vendor_id, product_id));
+    if (entry != NULL && entry->used) {
+        return entry->adapter;
     }
 
     struct DancePadAdapter invalidAdapter;
+    memset(&invalidAdapter, 0, sizeof(invalidAdapter));
     invalidAdapter.is_valid = false;
     return invalidAdapter;
 }
@@ -27,6 +95,15 @@ extern bool dance_pad_is_pid_vid_valid_pad(uint16_t vendor_id, uint16_t product_
 }
 
 // Default adapter method for pads that don't have a concept of P1/P2 -- just send back "Unknown"
-extern DancePadAdapterPlayer default_dance_pad_unknown_get_player(libusb_device_handle *handle, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint) {
+extern DancePadAdapterPlayer default_dance_pad_unknown_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint) {
     return DancePadAdapterPlayerUnknown;
-}
\ No newline at end of file
+}
+
+// For pads that are wired to one side of a cabinet and always belong to that player
+extern DancePadAdapterPlayer dance_pad_player1_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint) {
+    return DancePadAdapterPlayer1;
+}
+
+extern DancePadAdapterPlayer dance_pad_player2_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint) {
+    return DancePadAdapterPlayer2;
+}
@@ -6,7 +6,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <libusb.h>
+#include <stddef.h>
 
 typedef enum {
     DancePadAdapterPlayerUnknown = -1,
@@ -14,12 +14,56 @@ typedef enum {
     DancePadAdapterPlayer2,
 } DancePadAdapterPlayerEnum; typedef int DancePadAdapterPlayer;
 
+typedef enum {
+    DancePadAdapterReportIgnored         = 0,
+    DancePadAdapterReportInput           = 1 << 0, // Carries button state for input_converter
+    DancePadAdapterReportResponseStart   = 1 << 1, // First packet of a command response
+    DancePadAdapterReportResponseEnd     = 1 << 2, // Last packet of a command response
+    DancePadAdapterReportCommandFinished = 1 << 3, // The pad is done with the last command it was sent
+} DancePadAdapterReportFlagsEnum; typedef int DancePadAdapterReportFlags;
+
+// Blocking interrupt transfers on an opened pad, provided by whichever transport opened it. Returns 0 on
+// success or a negative error, like libusb_interrupt_transfer.
+struct DancePadAdapterIO {
+    void *context;
+    int (*interrupt_transfer)(void *context, uint8_t endpoint, uint8_t *data, int length, int *transferred, unsigned int timeout);
+};
+
+struct DancePadAdapterLayout;
+
 struct DancePadAdapter {
     bool is_valid;
     uint16_t vendor_id;
     uint16_t product_id;
     uint16_t (*input_converter)(uint8_t[], int);
-    DancePadAdapterPlayer (*get_player)(libusb_device_handle*, uint8_t, uint8_t);
+    // Optional: input_converter over `count` reports stored `stride` bytes apart, in one call
+    void (*input_converter_batch)(const uint8_t *reports, int stride, const int *lengths, int count, uint16_t *states);
+    DancePadAdapterPlayer (*get_player)(struct DancePadAdapterIO*, uint8_t, uint8_t);
+
+    // Optional: get_player's question and answer on their own, so the SDK can ask again over the streaming
+    // endpoints about a pad whose player it remembered rather than asked. player_query writes the packet
+    // that asks (padded to `packet_size`) and returns its length, or 0. player_reply returns the player a
+    // report answers with, or DancePadAdapterPlayerUnknown if the report isn't the answer.
+    int (*player_query)(uint8_t *packet, int packet_size);
+    DancePadAdapterPlayer (*player_reply)(const uint8_t *report, int length);
+
+    // Optional: when set, reports are converted through this table (see AdapterLayout.h) instead of
+    // input_converter, which lets pads described at runtime work without code of their own
+    const struct DancePadAdapterLayout *layout;
+
+    // How long a panel has to read released before the release is reported, to ride out contact chatter.
+    // Presses are never delayed. 0 reports every change as it arrives.
+    uint32_t release_hold_us;
+
+    // Optional command protocol over the interrupt endpoints. Pads that only send input leave these NULL,
+    // in which case every report goes to input_converter and nothing is ever sent to the pad.
+    //
+    // classify_report says what an incoming report is, and points `payload` at any bytes it carries of a
+    // response to a command; anything else the pad sends (input, or replies meant for get_player) has none.
+    // packetize_command writes the packet at `offset` into `command` to `packet` (padded to `packet_size`)
+    // and returns how many command bytes it consumed.
+    DancePadAdapterReportFlags (*classify_report)(uint8_t[], int, const uint8_t **payload, int *payload_length);
+    int (*packetize_command)(const uint8_t *command, int length, int offset, uint8_t *packet, int packet_size);
 };
 
 typedef enum {
@@ -49,9 +93,14 @@ typedef enum {
         DancePadAdapterInputDownLeft | DancePadAdapterInputDownRight,
 } DancePadAdapterInputEnum; typedef uint16_t DancePadAdapterInput;
 
+// The adapter registry starts with the built-in adapters. Registering a VID/PID that's already known
+// replaces its adapter. Not thread-safe: register before the SDK is initialized.
+bool dance_pad_adapter_register(const struct DancePadAdapter *adapter);
 struct DancePadAdapter dance_pad_adapter_for(uint16_t vendor_id, uint16_t product_id);
 bool dance_pad_is_pid_vid_valid_pad(uint16_t vendor_id, uint16_t product_id);
-DancePadAdapterPlayer default_dance_pad_unknown_get_player(libusb_device_handle *handle, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint);
+DancePadAdapterPlayer default_dance_pad_unknown_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint);
+DancePadAdapterPlayer dance_pad_player1_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint);
+DancePadAdapterPlayer dance_pad_player2_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint);
 
 #ifdef __cplusplus
 }
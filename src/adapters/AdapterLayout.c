@@ -0,0 +1,85 @@
+#include "AdapterLayout.h"
+#include <string.h>
+
+// Index of the table for report byte `byte`, adding one if needed; -1 if the layout is full
+static int layout_slot(struct DancePadAdapterLayout *layout, uint8_t byte) {
+    int slot = 0;
+    while (slot < layout->byte_count && layout->byte_offset[slot] != byte) {
+        slot++;
+    }
+    if (slot == layout->byte_count) {
+        if (layout->byte_count == DANCE_PAD_LAYOUT_MAX_BYTES) {
+            return -1;
+        }
+        layout->byte_offset[slot] = byte;
+        layout->byte_count++;
+    }
+    if (byte + 1 > layout->min_length) {
+        layout->min_length = byte + 1;
+    }
+    return slot;
+}
+
+bool dance_pad_layout_build(const struct DancePadAdapterBitMapping *mappings, int count, struct DancePadAdapterLayout *layout) {
+    memset(layout, 0, sizeof(*layout));
+
+    for (int i = 0; i < count; i++) {
+        int slot = layout_slot(layout, mappings[i].byte);
+        if (slot < 0) {
+            return false;
+        }
+        for (int value = 0; value < 256; value++) {
+            layout->table[slot][value] |= DANCE_PAD_LAYOUT_BIT(value, mappings[i].mask, mappings[i].input);
+        }
+    }
+    return true;
+}
+
+bool dance_pad_layout_add_field(struct DancePadAdapterLayout *layout, uint8_t byte, uint8_t shift, uint8_t mask,
+                                const DancePadAdapterInput *inputs) {
+    int slot = layout_slot(layout, byte);
+    if (slot < 0) {
+        return false;
+    }
+    for (int value = 0; value < 256; value++) {
+        layout->table[slot][value] |= inputs[(value >> shift) & mask];
+    }
+    return true;
+}
+
+void dance_pad_layout_convert_batch(const struct DancePadAdapterLayout *layout, const uint8_t *reports, int stride,
+                                    const int *lengths, int count, uint16_t *states) {
+    // Every table lookup stays inside its report's slot, so short reports can be masked out afterwards
+    // instead of branched around
+    if (stride < layout->min_length) {
+        for (int i = 0; i < count; i++) {
+            states[i] = dance_pad_layout_convert(layout, &reports[(size_t)i * stride], lengths[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *data = &reports[(size_t)i * stride];
+        uint16_t result = 0;
+        for (int j = 0; j < layout->byte_count; j++) {
+            result |= layout->table[j][data[layout->byte_offset[j]]];
+        }
+        uint16_t valid = (uint16_t)-(lengths[i] >= layout->min_length);
+        states[i] = result & valid;
+    }
+}
+
+void dance_pad_adapter_convert_batch(const struct DancePadAdapter *adapter, const uint8_t *reports, int stride,
+                                     const int *lengths, int count, uint16_t *states) {
+    if (adapter->layout) {
+        dance_pad_layout_convert_batch(adapter->layout, reports, stride, lengths, count, states);
+        return;
+    }
+    if (adapter->input_converter_batch) {
+        adapter->input_converter_batch(reports, stride, lengths, count, states);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        states[i] = adapter->input_converter((uint8_t *)&reports[(size_t)i * stride], lengths[i]);
+    }
+}
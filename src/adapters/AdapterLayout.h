@@ -0,0 +1,84 @@
+#ifndef DANCEPADADAPTERLAYOUT_H
+#define DANCEPADADAPTERLAYOUT_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "AdapterBase.h"
+
+#define DANCE_PAD_LAYOUT_MAX_BYTES 8
+
+// One bit of an input report: if `data[byte] & mask` is set, `input` is pressed
+struct DancePadAdapterBitMapping {
+    uint8_t byte;
+    uint8_t mask;
+    DancePadAdapterInput input;
+};
+
+// A report layout compiled into one 256-entry table per report byte that carries buttons, so converting a
+// report is a handful of loads and ORs with no branches
+struct DancePadAdapterLayout {
+    int min_length;    // Reports shorter than this convert to no input
+    uint8_t report_id; // For numbered reports, the ID in byte 0 that carries the buttons; 0 if unnumbered
+    int byte_count;
+    uint8_t byte_offset[DANCE_PAD_LAYOUT_MAX_BYTES];
+    uint16_t table[DANCE_PAD_LAYOUT_MAX_BYTES][256];
+};
+
+// Builds the tables at compile time. MAP(value) gives the inputs held for one value of a report byte,
+// normally as a list of DANCE_PAD_LAYOUT_BIT terms ORed together.
+#define DANCE_PAD_LAYOUT_BIT(value, mask, input) ((((value) & (mask)) != 0) ? (uint16_t)(input) : 0)
+#define DANCE_PAD_LAYOUT_TABLE_4(MAP, base)  MAP((base)), MAP((base) + 1), MAP((base) + 2), MAP((base) + 3)
+#define DANCE_PAD_LAYOUT_TABLE_16(MAP, base) DANCE_PAD_LAYOUT_TABLE_4(MAP, (base)), DANCE_PAD_LAYOUT_TABLE_4(MAP, (base) + 4), \
+                                             DANCE_PAD_LAYOUT_TABLE_4(MAP, (base) + 8), DANCE_PAD_LAYOUT_TABLE_4(MAP, (base) + 12)
+#define DANCE_PAD_LAYOUT_TABLE_64(MAP, base) DANCE_PAD_LAYOUT_TABLE_16(MAP, (base)), DANCE_PAD_LAYOUT_TABLE_16(MAP, (base) + 16), \
+                                             DANCE_PAD_LAYOUT_TABLE_16(MAP, (base) + 32), DANCE_PAD_LAYOUT_TABLE_16(MAP, (base) + 48)
+#define DANCE_PAD_LAYOUT_TABLE(MAP)          { DANCE_PAD_LAYOUT_TABLE_64(MAP, 0), DANCE_PAD_LAYOUT_TABLE_64(MAP, 64), \
+                                               DANCE_PAD_LAYOUT_TABLE_64(MAP, 128), DANCE_PAD_LAYOUT_TABLE_64(MAP, 192) }
+
+// Builds a layout at runtime, for mappings that aren't known until the pad is seen. Returns false if the
+// mappings use more distinct bytes than a layout can hold.
+bool dance_pad_layout_build(const struct DancePadAdapterBitMapping *mappings, int count, struct DancePadAdapterLayout *layout);
+
+// Adds a multi-bit field to a layout: `(data[byte] >> shift) & mask` indexes `inputs`, which must have mask + 1
+// entries. Used for fields like hat switches, where a value rather than a bit means a direction.
+bool dance_pad_layout_add_field(struct DancePadAdapterLayout *layout, uint8_t byte, uint8_t shift, uint8_t mask,
+                                const DancePadAdapterInput *inputs);
+
+// False for numbered reports other than the one the layout reads
+static inline bool dance_pad_layout_matches(const struct DancePadAdapterLayout *layout, const uint8_t data[], int length) {
+    return layout->report_id == 0 || (length > 0 && data[0] == layout->report_id);
+}
+
+static inline uint16_t dance_pad_layout_convert(const struct DancePadAdapterLayout *layout, const uint8_t data[], int length) {
+    if (length < layout->min_length) {
+        return 0;
+    }
+    uint16_t result = 0;
+    for (int i = 0; i < layout->byte_count; i++) {
+        result |= layout->table[i][data[layout->byte_offset[i]]];
+    }
+    return result;
+}
+
+// Converts one report with whichever of the adapter's layout or input_converter it has
+static inline uint16_t dance_pad_adapter_convert(const struct DancePadAdapter *adapter, uint8_t data[], int length) {
+    if (adapter->layout) {
+        return dance_pad_layout_convert(adapter->layout, data, length);
+    }
+    return adapter->input_converter(data, length);
+}
+
+// Converts `count` reports stored `stride` bytes apart, with `lengths[i]` the size of report i. Reports
+// the layout doesn't match should be filtered out first.
+void dance_pad_layout_convert_batch(const struct DancePadAdapterLayout *layout, const uint8_t *reports, int stride,
+                                    const int *lengths, int count, uint16_t *states);
+
+// Batch conversion through an adapter's layout or batch converter, falling back to one input_converter call per report
+void dance_pad_adapter_convert_batch(const struct DancePadAdapter *adapter, const uint8_t *reports, int stride,
+                                     const int *lengths, int count, uint16_t *states);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,236 @@
+#include "AdapterMappingFile.h"
+#include "AdapterLayout.h"
+#include "SMXStage/SMXStageAdapter.h"
+#include "FoamPad/FoamPadAdapter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAPPING_MAX_BITS 64
+#define MAPPING_MAX_REPORT_BYTE 64
+#define MAPPING_MAX_RELEASE_HOLD_US 1000000
+
+struct MappingPad {
+    bool active;
+    struct DancePadAdapter adapter;
+    struct DancePadAdapterBitMapping bits[MAPPING_MAX_BITS];
+    int bit_count;
+};
+
+// Layouts built from mapping files, so one that gets replaced by a later load can be freed
+struct OwnedLayout {
+    struct DancePadAdapterLayout *layout;
+    struct OwnedLayout *next;
+};
+static struct OwnedLayout *owned_layouts = NULL;
+
+static const struct {
+    const char *name;
+    DancePadAdapterInput input;
+} k_input_names[] = {
+    { "left",      DancePadAdapterInputLeft },
+    { "down",      DancePadAdapterInputDown },
+    { "up",        DancePadAdapterInputUp },
+    { "right",     DancePadAdapterInputRight },
+    { "upleft",    DancePadAdapterInputUpLeft },
+    { "upright",   DancePadAdapterInputUpRight },
+    { "center",    DancePadAdapterInputCenter },
+    { "downleft",  DancePadAdapterInputDownLeft },
+    { "downright", DancePadAdapterInputDownRight },
+    { "start",     DancePadAdapterInputStart },
+    { "select",    DancePadAdapterInputSelect },
+};
+
+static bool parse_number(const char *token, unsigned long max, unsigned long *value) {
+    if (token == NULL) {
+        return false;
+    }
+    char *end;
+    *value = strtoul(token, &end, 0);
+    return end != token && *end == '\0' && *value <= max;
+}
+
+static void free_replaced_layout(const struct DancePadAdapterLayout *layout) {
+    struct OwnedLayout **link = &owned_layouts;
+    while (*link) {
+        if ((*link)->layout == layout) {
+            struct OwnedLayout *owned = *link;
+            *link = owned->next;
+            free(owned->layout);
+            free(owned);
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+static bool finish_pad(struct MappingPad *pad) {
+    if (!pad->active) {
+        return true;
+    }
+    pad->active = false;
+
+    struct OwnedLayout *owned = NULL;
+    if (pad->bit_count > 0) {
+        owned = (struct OwnedLayout *)malloc(sizeof(*owned));
+        struct DancePadAdapterLayout *layout = (struct DancePadAdapterLayout *)malloc(sizeof(*layout));
+        if (owned == NULL || layout == NULL || !dance_pad_layout_build(pad->bits, pad->bit_count, layout)) {
+            free(owned);
+            free(layout);
+            return false;
+        }
+        owned->layout = layout;
+        pad->adapter.layout = layout;
+        pad->adapter.input_converter = NULL;
+        pad->adapter.input_converter_batch = NULL;
+    }
+
+    const struct DancePadAdapterLayout *previous = dance_pad_adapter_for(pad->adapter.vendor_id, pad->adapter.product_id).layout;
+    if (!dance_pad_adapter_register(&pad->adapter)) {
+        if (owned) {
+            free(owned->layout);
+            free(owned);
+        }
+        return false;
+    }
+    if (previous) {
+        free_replaced_layout(previous);
+    }
+    if (owned) {
+        owned->next = owned_layouts;
+        owned_layouts = owned;
+    }
+    return true;
+}
+
+static bool parse_line(char *line, struct MappingPad *pad) {
+    char *comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    const char *separators = " \t\r\n";
+    char *keyword = strtok(line, separators);
+    if (keyword == NULL) {
+        return true;
+    }
+
+    if (strcmp(keyword, "pad") == 0) {
+        unsigned long vendor_id, product_id;
+        if (!finish_pad(pad) ||
+            !parse_number(strtok(NULL, separators), 0xFFFF, &vendor_id) ||
+            !parse_number(strtok(NULL, separators), 0xFFFF, &product_id)) {
+            return false;
+        }
+        memset(pad, 0, sizeof(*pad));
+        pad->active = true;
+        pad->adapter.is_valid = true;
+        pad->adapter.vendor_id = (uint16_t)vendor_id;
+        pad->adapter.product_id = (uint16_t)product_id;
+        pad->adapter.get_player = default_dance_pad_unknown_get_player;
+        return strtok(NULL, separators) == NULL;
+    }
+
+    // Everything else describes the current pad
+    if (!pad->active) {
+        return false;
+    }
+    char *argument = strtok(NULL, separators);
+    if (argument == NULL) {
+        return false;
+    }
+
+    if (strcmp(keyword, "like") == 0) {
+        struct DancePadAdapter base;
+        if (strcmp(argument, "smx") == 0) {
+            base = default_smx_adapter();
+        } else if (strcmp(argument, "foam") == 0) {
+            base = default_foam_pad_adapter();
+        } else {
+            return false;
+        }
+        base.vendor_id = pad->adapter.vendor_id;
+        base.product_id = pad->adapter.product_id;
+        pad->adapter = base;
+    } else if (strcmp(keyword, "bit") == 0) {
+        unsigned long byte, mask;
+        const char *input_name = NULL;
+        if (!parse_number(argument, MAPPING_MAX_REPORT_BYTE - 1, &byte) ||
+            !parse_number(strtok(NULL, separators), 0xFF, &mask) || mask == 0 ||
+            (input_name = strtok(NULL, separators)) == NULL ||
+            pad->bit_count == MAPPING_MAX_BITS) {
+            return false;
+        }
+
+        int input = -1;
+        for (size_t i = 0; i < sizeof(k_input_names) / sizeof(k_input_names[0]); i++) {
+            if (strcmp(input_name, k_input_names[i].name) == 0) {
+                input = k_input_names[i].input;
+            }
+        }
+        if (input < 0) {
+            return false;
+        }
+        pad->bits[pad->bit_count].byte = (uint8_t)byte;
+        pad->bits[pad->bit_count].mask = (uint8_t)mask;
+        pad->bits[pad->bit_count].input = (DancePadAdapterInput)input;
+        pad->bit_count++;
+    } else if (strcmp(keyword, "player") == 0) {
+        struct DancePadAdapter smx = default_smx_adapter();
+        pad->adapter.player_query = NULL;
+        pad->adapter.player_reply = NULL;
+        if (strcmp(argument, "unknown") == 0) {
+            pad->adapter.get_player = default_dance_pad_unknown_get_player;
+        } else if (strcmp(argument, "smx") == 0) {
+            pad->adapter.get_player = smx.get_player;
+            pad->adapter.player_query = smx.player_query;
+            pad->adapter.player_reply = smx.player_reply;
+        } else if (strcmp(argument, "p1") == 0) {
+            pad->adapter.get_player = dance_pad_player1_get_player;
+        } else if (strcmp(argument, "p2") == 0) {
+            pad->adapter.get_player = dance_pad_player2_get_player;
+        } else {
+            return false;
+        }
+    } else if (strcmp(keyword, "release_hold") == 0) {
+        unsigned long hold_us;
+        if (!parse_number(argument, MAPPING_MAX_RELEASE_HOLD_US, &hold_us)) {
+            return false;
+        }
+        pad->adapter.release_hold_us = (uint32_t)hold_us;
+    } else {
+        return false;
+    }
+
+    return strtok(NULL, separators) == NULL;
+}
+
+extern bool dance_pad_adapter_load_mappings(const char *path, int *error_line) {
+    *error_line = 0;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+
+    struct MappingPad pad;
+    memset(&pad, 0, sizeof(pad));
+    char line[256];
+    int line_number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (!parse_line(line, &pad)) {
+            ok = false;
+            break;
+        }
+    }
+    if (ok && !finish_pad(&pad)) {
+        ok = false;
+    }
+
+    fclose(file);
+    if (!ok) {
+        *error_line = line_number;
+    }
+    return ok;
+}
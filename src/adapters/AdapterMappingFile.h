@@ -0,0 +1,38 @@
+#ifndef DANCEPADADAPTERMAPPINGFILE_H
+#define DANCEPADADAPTERMAPPINGFILE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "AdapterBase.h"
+
+// Registers the pads described in a mapping file, so new pads can be supported without a rebuild. The
+// file is line-based; `#` starts a comment and numbers may be decimal or 0x-prefixed hex.
+//
+//   pad <vendor id> <product id>   Starts a pad. Everything below applies to it until the next `pad`.
+//   like smx|foam                  Starts from a built-in adapter: its report format, commands and player detection.
+//   bit <byte> <mask> <input>      Input is held while report[byte] & mask is nonzero. Any `bit` lines replace
+//                                  the report format from `like`. Inputs: left down up right upleft upright
+//                                  center downleft downright start select.
+//   player unknown|smx|p1|p2       How the pad's player is found: not at all, by asking it like an SMX stage,
+//                                  or fixed to one side.
+//   release_hold <microseconds>    Only report a panel released once it has read released this long, for
+//                                  pads whose contacts chatter. Presses are still reported immediately.
+//
+// For example, a foam pad that reports arrows in byte 5:
+//
+//   pad 0x0079 0x0011
+//   bit 5 0x40 left
+//   bit 5 0x20 down
+//   bit 5 0x10 up
+//   bit 5 0x80 right
+//
+// Returns false if the file can't be read or has an error, with `error_line` set to the offending line
+// (0 if the file couldn't be opened). Pads before the error are still registered. Like
+// dance_pad_adapter_register, this must not run while the SDK is initialized.
+bool dance_pad_adapter_load_mappings(const char *path, int *error_line);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,34 +1,39 @@
 #include "FoamPadAdapter.h"
+#include "../AdapterLayout.h"
 
 static const uint16_t k_vendor_id  = 0x0079;
 static const uint16_t k_product_id = 0x0011;
 
+// Report byte 5 holds the arrows
+#define FOAM_ARROW_BUTTONS(value) (uint16_t)( \
+    DANCE_PAD_LAYOUT_BIT(value, 0x40, DancePadAdapterInputLeft) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x20, DancePadAdapterInputDown) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x10, DancePadAdapterInputUp) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x80, DancePadAdapterInputRight))
+
+// Report byte 6 holds the diagonals, Start and Select
+#define FOAM_ACTION_BUTTONS(value) (uint16_t)( \
+    DANCE_PAD_LAYOUT_BIT(value, 0x04, DancePadAdapterInputUpLeft) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x08, DancePadAdapterInputUpRight) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x01, DancePadAdapterInputDownLeft) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x02, DancePadAdapterInputDownRight) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x20, DancePadAdapterInputStart) | \
+    DANCE_PAD_LAYOUT_BIT(value, 0x10, DancePadAdapterInputSelect))
+
+static const struct DancePadAdapterLayout k_foam_layout = {
+    7,
+    0,
+    2,
+    { 5, 6 },
+    { DANCE_PAD_LAYOUT_TABLE(FOAM_ARROW_BUTTONS), DANCE_PAD_LAYOUT_TABLE(FOAM_ACTION_BUTTONS) },
+};
+
 uint16_t foam_input_converter(uint8_t data[], int length) {
-    if (length < 7) {
-        return 0;
-    }
-
-    uint8_t arrow_buttons  = data[5];
-    uint8_t action_buttons = data[6];
-    DancePadAdapterInput result = DancePadAdapterInputNone;
-
-    // Map arrows
-    if (arrow_buttons & 0x40) result |= DancePadAdapterInputLeft;
-    if (arrow_buttons & 0x20) result |= DancePadAdapterInputDown;
-    if (arrow_buttons & 0x10) result |= DancePadAdapterInputUp;
-    if (arrow_buttons & 0x80) result |= DancePadAdapterInputRight;
-
-    // Map diagonals
-    if (action_buttons & 0x04) result |= DancePadAdapterInputUpLeft;
-    if (action_buttons & 0x08) result |= DancePadAdapterInputUpRight;
-    if (action_buttons & 0x01) result |= DancePadAdapterInputDownLeft;
-    if (action_buttons & 0x02) result |= DancePadAdapterInputDownRight;
-
-    // Start and Select
-    if (action_buttons & 0x20) result |= DancePadAdapterInputStart;
-    if (action_buttons & 0x10) result |= DancePadAdapterInputSelect;
-
-    return (uint16_t)result;
+    return dance_pad_layout_convert(&k_foam_layout, data, length);
+}
+
+void foam_input_converter_batch(const uint8_t *reports, int stride, const int *lengths, int count, uint16_t *states) {
+    dance_pad_layout_convert_batch(&k_foam_layout, reports, stride, lengths, count, states);
 }
 
 extern struct DancePadAdapter default_foam_pad_adapter() {
@@ -37,7 +42,14 @@ extern struct DancePadAdapter default_foam_pad_adapter() {
     adapter.vendor_id = k_vendor_id;
     adapter.product_id = k_product_id;
     adapter.input_converter = foam_input_converter;
+    adapter.input_converter_batch = foam_input_converter_batch;
+    adapter.layout = &k_foam_layout;
+    adapter.release_hold_us = 0;
     adapter.get_player = default_dance_pad_unknown_get_player; // This foam pad doesn't have an in-built concept of P1/P2, so send back "unknown"
+    adapter.player_query = NULL;
+    adapter.player_reply = NULL;
+    adapter.classify_report = NULL;
+    adapter.packetize_command = NULL;
     adapter.is_valid = true;
 
     return adapter;
@@ -0,0 +1,355 @@
+#include "HIDPadAdapter.h"
+#include <string.h>
+
+// Item prefixes with the size bits masked off
+#define HID_ITEM_INPUT          0x80
+#define HID_ITEM_COLLECTION     0xA0
+#define HID_ITEM_END_COLLECTION 0xC0
+#define HID_ITEM_USAGE_PAGE     0x04
+#define HID_ITEM_LOGICAL_MIN    0x14
+#define HID_ITEM_LOGICAL_MAX    0x24
+#define HID_ITEM_REPORT_SIZE    0x74
+#define HID_ITEM_REPORT_ID      0x84
+#define HID_ITEM_REPORT_COUNT   0x94
+#define HID_ITEM_PUSH           0xA4
+#define HID_ITEM_POP            0xB4
+#define HID_ITEM_USAGE          0x08
+#define HID_ITEM_USAGE_MIN      0x18
+#define HID_ITEM_USAGE_MAX      0x28
+#define HID_ITEM_LONG           0xFE
+
+#define HID_PAGE_GENERIC_DESKTOP 0x01
+#define HID_PAGE_BUTTON          0x09
+#define HID_USAGE_JOYSTICK       0x04
+#define HID_USAGE_GAMEPAD        0x05
+#define HID_USAGE_HAT_SWITCH     0x39
+#define HID_USAGE_DPAD_UP        0x90
+#define HID_USAGE_DPAD_DOWN      0x91
+#define HID_USAGE_DPAD_RIGHT     0x92
+#define HID_USAGE_DPAD_LEFT      0x93
+
+#define HID_INPUT_CONSTANT 0x01
+#define HID_INPUT_VARIABLE 0x02
+
+#define HID_MAX_USAGES      32
+#define HID_MAX_GLOBAL_STACK 4
+#define HID_MAX_REPORT_IDS  256
+
+static const DancePadAdapterInput k_button_inputs[] = {
+    DancePadAdapterInputLeft,
+    DancePadAdapterInputDown,
+    DancePadAdapterInputUp,
+    DancePadAdapterInputRight,
+    DancePadAdapterInputUpLeft,
+    DancePadAdapterInputUpRight,
+    DancePadAdapterInputDownLeft,
+    DancePadAdapterInputDownRight,
+    DancePadAdapterInputSelect,
+    DancePadAdapterInputStart,
+    DancePadAdapterInputCenter,
+};
+
+// Hat switch positions clockwise from up. Diagonals hold both arrows, as stepping on a corner would.
+static const DancePadAdapterInput k_hat_inputs[8] = {
+    DancePadAdapterInputUp,
+    DancePadAdapterInputUp | DancePadAdapterInputRight,
+    DancePadAdapterInputRight,
+    DancePadAdapterInputDown | DancePadAdapterInputRight,
+    DancePadAdapterInputDown,
+    DancePadAdapterInputDown | DancePadAdapterInputLeft,
+    DancePadAdapterInputLeft,
+    DancePadAdapterInputUp | DancePadAdapterInputLeft,
+};
+
+struct HIDGlobals {
+    uint32_t usage_page;
+    int32_t logical_min;
+    int32_t logical_max;
+    uint32_t report_size;
+    uint32_t report_count;
+    uint8_t report_id;
+};
+
+struct HIDParser {
+    struct HIDGlobals globals;
+    struct HIDGlobals stack[HID_MAX_GLOBAL_STACK];
+    int stack_depth;
+
+    // Local items, cleared after every main item
+    uint32_t usages[HID_MAX_USAGES];
+    int usage_count;
+    uint32_t usage_min;
+    uint32_t usage_max;
+    bool has_usage_range;
+
+    int collection_depth;
+    int pad_collection_depth; // Depth of the joystick/gamepad collection we're inside, or 0
+    uint32_t bit_offset[HID_MAX_REPORT_IDS]; // Input bits seen so far per report ID
+    bool numbered;
+
+    struct DancePadAdapterLayout *layout;
+    bool have_report;
+    uint8_t report_id;
+    int mapped_inputs;
+    bool failed;
+};
+
+DancePadAdapterInput hid_pad_button_input(int button) {
+    if (button < 1 || button > (int)(sizeof(k_button_inputs) / sizeof(k_button_inputs[0]))) {
+        return DancePadAdapterInputNone;
+    }
+    return k_button_inputs[button - 1];
+}
+
+static uint32_t item_unsigned(const uint8_t *data, int size) {
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= (uint32_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+static int32_t item_signed(const uint8_t *data, int size) {
+    uint32_t value = item_unsigned(data, size);
+    if (size > 0 && size < 4 && (value & (1u << (8 * size - 1)))) {
+        value |= ~0u << (8 * size);
+    }
+    return (int32_t)value;
+}
+
+// Full 32-bit usage (page in the high half) of field `index` in the current main item
+static uint32_t field_usage(const struct HIDParser *parser, uint32_t index) {
+    uint32_t usage;
+    if (parser->usage_count > 0) {
+        usage = parser->usages[index < (uint32_t)parser->usage_count ? index : (uint32_t)parser->usage_count - 1];
+    } else if (parser->has_usage_range) {
+        usage = parser->usage_min + index;
+        if (usage > parser->usage_max) {
+            usage = parser->usage_max;
+        }
+    } else {
+        return 0;
+    }
+    // Usages given without a page take the current usage page
+    if ((usage >> 16) == 0) {
+        usage |= parser->globals.usage_page << 16;
+    }
+    return usage;
+}
+
+// The first report ID with a mapped field is the one the layout reads; fields in other reports are ignored
+static bool use_report(struct HIDParser *parser) {
+    if (!parser->have_report) {
+        parser->have_report = true;
+        parser->report_id = parser->globals.report_id;
+        parser->layout->report_id = parser->globals.report_id;
+    }
+    return parser->report_id == parser->globals.report_id;
+}
+
+static void map_field(struct HIDParser *parser, uint32_t usage, uint32_t bit, uint32_t size) {
+    uint32_t page = usage >> 16;
+    uint32_t id = usage & 0xFFFF;
+    uint32_t byte = bit / 8;
+    uint32_t shift = bit % 8;
+
+    // Fields are only usable if they sit within one byte of the report
+    if (byte >= 64 || shift + size > 8) {
+        return;
+    }
+
+    if (size == 1) {
+        DancePadAdapterInput input = DancePadAdapterInputNone;
+        if (page == HID_PAGE_BUTTON) {
+            input = hid_pad_button_input((int)id);
+        } else if (page == HID_PAGE_GENERIC_DESKTOP) {
+            switch (id) {
+                case HID_USAGE_DPAD_UP:    input = DancePadAdapterInputUp; break;
+                case HID_USAGE_DPAD_DOWN:  input = DancePadAdapterInputDown; break;
+                case HID_USAGE_DPAD_RIGHT: input = DancePadAdapterInputRight; break;
+                case HID_USAGE_DPAD_LEFT:  input = DancePadAdapterInputLeft; break;
+            }
+        }
+        if (input == DancePadAdapterInputNone || !use_report(parser)) {
+            return;
+        }
+        DancePadAdapterInput inputs[2] = { DancePadAdapterInputNone, input };
+        if (!dance_pad_layout_add_field(parser->layout, (uint8_t)byte, (uint8_t)shift, 1, inputs)) {
+            parser->failed = true;
+            return;
+        }
+        parser->mapped_inputs++;
+        return;
+    }
+
+    if (page == HID_PAGE_GENERIC_DESKTOP && id == HID_USAGE_HAT_SWITCH) {
+        // Four- or eight-way hats; anything outside the logical range is the centered "null" position
+        int32_t positions = parser->globals.logical_max - parser->globals.logical_min + 1;
+        if ((positions != 4 && positions != 8) || !use_report(parser)) {
+            return;
+        }
+        uint8_t mask = (uint8_t)((1u << size) - 1);
+        DancePadAdapterInput inputs[256];
+        memset(inputs, 0, sizeof(inputs));
+        for (int32_t value = 0; value <= mask; value++) {
+            int32_t position = value - parser->globals.logical_min;
+            if (position >= 0 && position < positions) {
+                inputs[value] = k_hat_inputs[position * (8 / positions)];
+            }
+        }
+        if (!dance_pad_layout_add_field(parser->layout, (uint8_t)byte, (uint8_t)shift, mask, inputs)) {
+            parser->failed = true;
+            return;
+        }
+        parser->mapped_inputs += 4;
+    }
+}
+
+static void handle_input(struct HIDParser *parser, uint32_t flags) {
+    uint32_t *offset = &parser->bit_offset[parser->globals.report_id];
+    uint32_t size = parser->globals.report_size;
+    uint32_t count = parser->globals.report_count;
+
+    bool mappable = parser->pad_collection_depth > 0 && !(flags & HID_INPUT_CONSTANT) && (flags & HID_INPUT_VARIABLE);
+    if (mappable) {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t bit = *offset + i * size;
+            // Numbered reports start with the ID byte
+            if (parser->numbered) {
+                bit += 8;
+            }
+            map_field(parser, field_usage(parser, i), bit, size);
+        }
+    }
+    *offset += size * count;
+}
+
+bool hid_pad_build_layout(const uint8_t *descriptor, int length, struct DancePadAdapterLayout *layout) {
+    struct HIDParser parser;
+    memset(&parser, 0, sizeof(parser));
+    memset(layout, 0, sizeof(*layout));
+    parser.layout = layout;
+
+    // Report IDs change where every field sits, so find out up front whether there are any
+    for (int i = 0; i < length; ) {
+        uint8_t prefix = descriptor[i];
+        if (prefix == HID_ITEM_LONG) {
+            if (i + 1 >= length) break;
+            i += 3 + descriptor[i + 1];
+            continue;
+        }
+        int size = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+        if ((prefix & 0xFC) == HID_ITEM_REPORT_ID) {
+            parser.numbered = true;
+        }
+        i += 1 + size;
+    }
+
+    int i = 0;
+    while (i < length && !parser.failed) {
+        uint8_t prefix = descriptor[i];
+        if (prefix == HID_ITEM_LONG) {
+            if (i + 1 >= length) break;
+            i += 3 + descriptor[i + 1];
+            continue;
+        }
+
+        int size = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+        if (i + 1 + size > length) {
+            break;
+        }
+        const uint8_t *data = &descriptor[i + 1];
+        uint32_t value = item_unsigned(data, size);
+        i += 1 + size;
+
+        bool main_item = false;
+        switch (prefix & 0xFC) {
+            case HID_ITEM_USAGE_PAGE:   parser.globals.usage_page = value; break;
+            case HID_ITEM_LOGICAL_MIN:  parser.globals.logical_min = item_signed(data, size); break;
+            case HID_ITEM_LOGICAL_MAX:  parser.globals.logical_max = item_signed(data, size); break;
+            case HID_ITEM_REPORT_SIZE:  parser.globals.report_size = value; break;
+            case HID_ITEM_REPORT_COUNT: parser.globals.report_count = value; break;
+            case HID_ITEM_REPORT_ID:    parser.globals.report_id = (uint8_t)value; break;
+            case HID_ITEM_PUSH:
+                if (parser.stack_depth < HID_MAX_GLOBAL_STACK) {
+                    parser.stack[parser.stack_depth++] = parser.globals;
+                }
+                break;
+            case HID_ITEM_POP:
+                if (parser.stack_depth > 0) {
+                    parser.globals = parser.stack[--parser.stack_depth];
+                }
+                break;
+            case HID_ITEM_USAGE:
+                if (parser.usage_count < HID_MAX_USAGES) {
+                    // A 4-byte usage carries its own page
+                    parser.usages[parser.usage_count++] = size == 4 ? value : (parser.globals.usage_page << 16) | value;
+                }
+                break;
+            case HID_ITEM_USAGE_MIN:
+                parser.usage_min = size == 4 ? value : (parser.globals.usage_page << 16) | value;
+                parser.has_usage_range = true;
+                break;
+            case HID_ITEM_USAGE_MAX:
+                parser.usage_max = size == 4 ? value : (parser.globals.usage_page << 16) | value;
+                parser.has_usage_range = true;
+                break;
+            case HID_ITEM_INPUT:
+                handle_input(&parser, value);
+                main_item = true;
+                break;
+            case HID_ITEM_COLLECTION: {
+                parser.collection_depth++;
+                uint32_t usage = field_usage(&parser, 0);
+                bool is_pad = (usage >> 16) == HID_PAGE_GENERIC_DESKTOP &&
+                              ((usage & 0xFFFF) == HID_USAGE_JOYSTICK || (usage & 0xFFFF) == HID_USAGE_GAMEPAD);
+                if (is_pad && parser.pad_collection_depth == 0) {
+                    parser.pad_collection_depth = parser.collection_depth;
+                }
+                main_item = true;
+                break;
+            }
+            case HID_ITEM_END_COLLECTION:
+                if (parser.collection_depth == parser.pad_collection_depth) {
+                    parser.pad_collection_depth = 0;
+                }
+                if (parser.collection_depth > 0) {
+                    parser.collection_depth--;
+                }
+                main_item = true;
+                break;
+            default:
+                // Output and feature items, and everything else, don't affect input reports
+                main_item = (prefix & 0x0C) == 0;
+                break;
+        }
+
+        if (main_item) {
+            parser.usage_count = 0;
+            parser.has_usage_range = false;
+        }
+    }
+
+    // Four arrows' worth of inputs is the least that could be a dance pad
+    return !parser.failed && parser.mapped_inputs >= 4;
+}
+
+struct DancePadAdapter hid_pad_adapter(uint16_t vendor_id, uint16_t product_id, const struct DancePadAdapterLayout *layout) {
+    struct DancePadAdapter adapter;
+    memset(&adapter, 0, sizeof(adapter));
+
+    adapter.vendor_id = vendor_id;
+    adapter.product_id = product_id;
+    adapter.input_converter = NULL;
+    adapter.input_converter_batch = NULL;
+    adapter.layout = layout;
+    adapter.release_hold_us = 0;
+    adapter.get_player = default_dance_pad_unknown_get_player; // Generic HID has no notion of P1/P2
+    adapter.player_query = NULL;
+    adapter.player_reply = NULL;
+    adapter.classify_report = NULL;
+    adapter.packetize_command = NULL;
+    adapter.is_valid = true;
+
+    return adapter;
+}
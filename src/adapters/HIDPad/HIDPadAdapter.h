@@ -0,0 +1,22 @@
+#ifndef HIDDANCEPADADAPTER_H
+#define HIDDANCEPADADAPTER_H
+
+#include "../AdapterBase.h"
+#include "../AdapterLayout.h"
+
+// Pads with no adapter of their own that describe themselves as a standard HID joystick or gamepad.
+// Their report descriptor is compiled into a layout, so conversion runs as fast as a hand-written adapter.
+//
+// Buttons 1-11 map to Left, Down, Up, Right, UpLeft, UpRight, DownLeft, DownRight, Select, Start and Center.
+// D-pad usages and a hat switch map to the arrows.
+
+// Returns false if the descriptor isn't a joystick or gamepad with enough inputs to be a pad
+bool hid_pad_build_layout(const uint8_t *descriptor, int length, struct DancePadAdapterLayout *layout);
+
+// Adapter for a pad whose layout came from hid_pad_build_layout. `layout` must outlive the adapter.
+struct DancePadAdapter hid_pad_adapter(uint16_t vendor_id, uint16_t product_id, const struct DancePadAdapterLayout *layout);
+
+// Which input a HID button number (1-based) maps to, or DancePadAdapterInputNone
+DancePadAdapterInput hid_pad_button_input(int button);
+
+#endif
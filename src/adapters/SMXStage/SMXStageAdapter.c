@@ -1,8 +1,23 @@
 #include "SMXStageAdapter.h"
+#include <string.h>
 
 static const uint16_t k_vendor_id  = 0x2341;
 static const uint16_t k_product_id = 0x8037;
 
+// HID report IDs: input state from the pad, command packets to the pad, and command data back from it
+static const uint8_t k_report_input    = 3;
+static const uint8_t k_report_command  = 5;
+static const uint8_t k_report_response = 6;
+
+// Flags in byte 1 of command and response packets
+static const uint8_t k_packet_end_of_command   = 0x01;
+static const uint8_t k_packet_host_cmd_done    = 0x02;
+static const uint8_t k_packet_start_of_command = 0x04;
+static const uint8_t k_packet_device_info      = 0x80;
+
+// Each packet is [report ID][flags][payload length][payload...]
+static const int k_packet_header_size = 3;
+
 uint16_t smx_input_converter(uint8_t data[], int length) {
     if (length < 3) {
         return 0;
@@ -11,18 +26,109 @@ uint16_t smx_input_converter(uint8_t data[], int length) {
     return ((data[2] & 0xFF) << 8) | ((data[1] & 0xFF) << 0);
 }
 
-DancePadAdapterPlayer smx_get_player(libusb_device_handle *handle, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint)
+void smx_input_converter_batch(const uint8_t *reports, int stride, const int *lengths, int count, uint16_t *states) {
+    if (stride < 3) {
+        for (int i = 0; i < count; i++) {
+            states[i] = smx_input_converter((uint8_t *)&reports[(size_t)i * stride], lengths[i]);
+        }
+        return;
+    }
+
+    // No branches in the loop body, so compilers can vectorize it
+    for (int i = 0; i < count; i++) {
+        const uint8_t *data = &reports[(size_t)i * stride];
+        uint16_t valid = (uint16_t)-(lengths[i] >= 3);
+        states[i] = (uint16_t)((data[2] << 8) | data[1]) & valid;
+    }
+}
+
+DancePadAdapterReportFlags smx_classify_report(uint8_t data[], int length, const uint8_t **payload, int *payload_length) {
+    if (length < 1) {
+        return DancePadAdapterReportIgnored;
+    }
+    if (data[0] == k_report_input) {
+        return DancePadAdapterReportInput;
+    }
+    if (data[0] != k_report_response || length < k_packet_header_size) {
+        return DancePadAdapterReportIgnored;
+    }
+
+    // Device info replies belong to smx_get_player, not to a queued command, so they carry no payload;
+    // otherwise they'd land in the middle of whatever response is being collected
+    uint8_t flags = data[1];
+    if (flags & k_packet_device_info) {
+        return DancePadAdapterReportIgnored;
+    }
+
+    int size = data[2];
+    if (size > length - k_packet_header_size) {
+        size = length - k_packet_header_size;
+    }
+    *payload = &data[k_packet_header_size];
+    *payload_length = size;
+
+    DancePadAdapterReportFlags result = DancePadAdapterReportIgnored;
+    if (flags & k_packet_start_of_command) result |= DancePadAdapterReportResponseStart;
+    if (flags & k_packet_end_of_command)   result |= DancePadAdapterReportResponseEnd;
+    if (flags & k_packet_host_cmd_done)    result |= DancePadAdapterReportCommandFinished;
+    return result;
+}
+
+int smx_packetize_command(const uint8_t *command, int length, int offset, uint8_t *packet, int packet_size) {
+    int chunk = length - offset;
+    if (chunk > packet_size - k_packet_header_size) {
+        chunk = packet_size - k_packet_header_size;
+    }
+    if (chunk > 0xFF) {
+        chunk = 0xFF;
+    }
+    if (chunk <= 0) {
+        return 0;
+    }
+
+    uint8_t flags = 0;
+    if (offset == 0)              flags |= k_packet_start_of_command;
+    if (offset + chunk == length) flags |= k_packet_end_of_command;
+
+    memset(packet, 0, packet_size);
+    packet[0] = k_report_command;
+    packet[1] = flags;
+    packet[2] = (uint8_t)chunk;
+    memcpy(&packet[k_packet_header_size], &command[offset], chunk);
+    return chunk;
+}
+
+// A device info request: an empty command packet with only the device info flag set
+int smx_player_query(uint8_t *packet, int packet_size) {
+    if (packet_size < k_packet_header_size) {
+        return 0;
+    }
+    memset(packet, 0, packet_size);
+    packet[0] = k_report_command;
+    packet[1] = k_packet_device_info;
+    return packet_size;
+}
+
+// The device info reply starts with the player as an ASCII digit
+DancePadAdapterPlayer smx_player_reply(const uint8_t *report, int length) {
+    if (length < 4 || report[0] != k_report_response || !(report[1] & k_packet_device_info)) {
+        return DancePadAdapterPlayerUnknown;
+    }
+    return (report[3] == '1') ? DancePadAdapterPlayer2 : DancePadAdapterPlayer1;
+}
+
+DancePadAdapterPlayer smx_get_player(struct DancePadAdapterIO *io, uint8_t interrupt_in_endpoint, uint8_t interrupt_out_endpoint)
 {
     if (interrupt_out_endpoint == 0)
     {
         return DancePadAdapterPlayerUnknown;
     }
 
-    const unsigned char data[] = {5, 0x80, 0};
+    unsigned char data[k_packet_header_size];
     int bytes_sent = 0;
-    int result = libusb_interrupt_transfer(handle, interrupt_out_endpoint,
-                                           (unsigned char *)data, sizeof(data),
-                                           &bytes_sent, 1000);
+    int result = io->interrupt_transfer(io->context, interrupt_out_endpoint,
+                                        data, smx_player_query(data, sizeof(data)),
+                                        &bytes_sent, 1000);
     if (result < 0 || bytes_sent < sizeof(data))
     {
         return DancePadAdapterPlayerUnknown;
@@ -30,16 +136,16 @@ DancePadAdapterPlayer smx_get_player(libusb_device_handle *handle, uint8_t inter
 
     unsigned char buf[65];
     int bytes_read = 0;
-    result = libusb_interrupt_transfer(handle, interrupt_in_endpoint,
-                                       buf, sizeof(buf),
-                                       &bytes_read, 1000);
+    result = io->interrupt_transfer(io->context, interrupt_in_endpoint,
+                                    buf, sizeof(buf),
+                                    &bytes_read, 1000);
 
-    if (result < 0 || bytes_read < 4)
+    if (result < 0)
     {
         return DancePadAdapterPlayerUnknown;
     }
 
-    return (buf[3] == '1') ? DancePadAdapterPlayer2 : DancePadAdapterPlayer1;
+    return smx_player_reply(buf, bytes_read);
 }
 
 extern struct DancePadAdapter default_smx_adapter() {
@@ -48,7 +154,14 @@ extern struct DancePadAdapter default_smx_adapter() {
     adapter.vendor_id = k_vendor_id;
     adapter.product_id = k_product_id;
     adapter.input_converter = smx_input_converter;
+    adapter.input_converter_batch = smx_input_converter_batch;
+    adapter.layout = NULL;
+    adapter.release_hold_us = 0; // Panels are debounced by the stage's own firmware
     adapter.get_player = smx_get_player;
+    adapter.player_query = smx_player_query;
+    adapter.player_reply = smx_player_reply;
+    adapter.classify_report = smx_classify_report;
+    adapter.packetize_command = smx_packetize_command;
     adapter.is_valid = true;
 
     return adapter;
@@ -1,308 +1,1598 @@
 #include "lowlatencydancegamesdk.h"
-#include <libusb.h>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <cassert>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 #endif
 
+#include "SPSCQueue.h"
+#include "TripleBuffer.h"
+#include "LatencyHistogram.h"
+#include "DebounceFilter.h"
+#include "PressHistory.h"
+#include "SeqlockLatch.h"
+#include "ClockEstimator.h"
+#include "DeviceCache.h"
+#include "SessionRecorder.h"
+#include "NotifyFd.h"
+#include "HotPathAudit.h"
+#include "MonotonicClock.h"
+#include "transport/LibusbTransport.h"
+#include "transport/SimulatedTransport.h"
+#include "transport/UsbfsTransport.h"
+
 extern "C" {
     #include "adapters/AdapterBase.h"
+    #include "adapters/AdapterLayout.h"
+    #include "adapters/AdapterMappingFile.h"
+    #include "adapters/HIDPad/HIDPadAdapter.h"
 }
 
-// Global libusb context for device management
-static libusb_context* g_libusb_ctx = nullptr;
+using ThreadOptions = LowLatencyDanceGameSDK::ThreadOptions;
+using ThreadReport = LowLatencyDanceGameSDK::ThreadReport;
 
-// Set current thread to high priority for low latency
-static void setThreadHighPriority() {
+// Locks `length` bytes at `address` into RAM, returning 0 or an errno value
+static int lockMemory(const void* address, size_t length) {
 #ifdef _WIN32
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
-#else // Linux and Mac
-    struct sched_param param;
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    (void)address;
+    (void)length;
+    return ENOTSUP;
+#else
+    return (length == 0 || mlock(address, length) == 0) ? 0 : errno;
 #endif
 }
 
-// Returns true if device_a should come before device_b in USB ordering
-static bool compareUSBLocation(libusb_device* device_a, libusb_device* device_b) {
-    uint8_t bus_a = libusb_get_bus_number(device_a);
-    uint8_t bus_b = libusb_get_bus_number(device_b);
-    if (bus_a != bus_b) return bus_a < bus_b;
+// Faults in and locks the stack the event loop will grow into, so deep calls don't page-fault later
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static int lockThreadStack() {
+    volatile uint8_t stack[64 * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+    return lockMemory(const_cast<uint8_t*>(stack), sizeof(stack));
+}
+
+// Applies `options` to the current thread and reports what took effect
+static ThreadReport configureThread(const ThreadOptions& options) {
+    ThreadReport report = {};
+    report.scheduling = ThreadOptions::Scheduling::Normal;
+    report.busy_poll = options.busy_poll;
     
-    uint8_t path_a[8], path_b[8];
-    int len_a = libusb_get_port_numbers(device_a, path_a, sizeof(path_a));
-    int len_b = libusb_get_port_numbers(device_b, path_b, sizeof(path_b));
+#ifdef _WIN32
+    if (options.scheduling != ThreadOptions::Scheduling::Normal) {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+            report.scheduling = ThreadOptions::Scheduling::RealTime;
+            report.priority = THREAD_PRIORITY_TIME_CRITICAL;
+        } else {
+            report.scheduling_error = static_cast<int>(GetLastError());
+        }
+    }
+    if (options.cpu_affinity) {
+        if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(options.cpu_affinity))) {
+            report.cpu_affinity = options.cpu_affinity;
+        } else {
+            report.affinity_error = static_cast<int>(GetLastError());
+        }
+    }
+#else // Linux and Mac
+    if (options.scheduling != ThreadOptions::Scheduling::Normal) {
+        int policy = options.scheduling == ThreadOptions::Scheduling::RoundRobin ? SCHED_RR : SCHED_FIFO;
+        struct sched_param param;
+        param.sched_priority = options.priority >= 0 ? options.priority : sched_get_priority_max(policy);
+        int result = pthread_setschedparam(pthread_self(), policy, &param);
+        if (result == 0) {
+            report.scheduling = options.scheduling;
+            report.priority = param.sched_priority;
+        } else {
+            report.scheduling_error = result;
+        }
+    }
+    if (options.cpu_affinity) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (options.cpu_affinity & (1ull << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result == 0) {
+            report.cpu_affinity = options.cpu_affinity;
+        } else {
+            report.affinity_error = result;
+        }
+#else
+        report.affinity_error = ENOTSUP;
+#endif
+    }
+#endif
     
-    int min_len = (len_a < len_b) ? len_a : len_b;
-    for (int i = 0; i < min_len; i++) {
-        if (path_a[i] != path_b[i]) return path_a[i] < path_b[i];
+    if (options.lock_memory) {
+        report.memory_lock_error = lockThreadStack();
+        report.memory_locked = report.memory_lock_error == 0;
     }
-    return len_a < len_b;
+    return report;
 }
 
+struct DeviceState;
+
+// Returns true if device_a should come before device_b in USB ordering
+static bool compareUSBLocation(const DeviceState* device_a, const DeviceState* device_b);
+
+// One queued interrupt-IN transfer and its slot in the device's submission ring
+struct InputTransfer {
+    PadTransfer* transfer = nullptr;
+    DeviceState* device = nullptr;
+    bool completed = false;
+};
+
+// Per-pad instrumentation, written by the USB thread only and readable from any thread
+struct DeviceStats {
+    LatencyHistogram report_interval;
+    LatencyHistogram completion_jitter;
+    LatencyHistogram converter_time;
+    LatencyHistogram callback_time;
+    std::atomic<uint64_t> reports{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> dropped_events{0};
+    uint64_t last_report_ns = 0;     // USB thread only
+    uint64_t last_interval_ns = 0;   // USB thread only
+
+    static void increment(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        report_interval.reset();
+        completion_jitter.reset();
+        converter_time.reset();
+        callback_time.reset();
+        reports.store(0, std::memory_order_relaxed);
+        timeouts.store(0, std::memory_order_relaxed);
+        errors.store(0, std::memory_order_relaxed);
+        dropped_events.store(0, std::memory_order_relaxed);
+        last_report_ns = 0;
+        last_interval_ns = 0;
+    }
+};
+
+// A command set by setRepeatingCommand(), as handed to the USB thread
+struct RepeatingCommand {
+    LowLatencyDanceGameSDK::LightsFrame frame; // Holds the one command, or none to stop
+    LowLatencyDanceGameSDK::ResponseCallback callback;
+    void* user_data;
+    uint32_t serial; // Tells responses to this command from ones to the command it replaced
+};
+
+// A command from sendCommand(), waiting for the USB thread
+struct QueuedCommand {
+    LowLatencyDanceGameSDK::LightsFrame frame; // Holds the one command
+    LowLatencyDanceGameSDK::CommandCallback callback;
+    void* user_data;
+};
+
+// Where asking a pad opened from the device cache for its player has got to
+enum class PlayerCheck {
+    None,
+    Due,  // pumpOutput() sends the question between frames
+    Sent, // Waiting for the answer among the pad's reports
+};
+
+// What the frame on the OUT endpoint is, so acks and responses can be matched up with it
+enum class OutputKind {
+    Lights,
+    Queued,
+    Repeating,
+};
+
+struct PublishedResponse {
+    LowLatencyDanceGameSDK::CommandResponse response;
+    uint32_t serial;
+};
+
+using PanelHistory = PressHistory<LowLatencyDanceGameSDK::PRESS_HISTORY_LENGTH>;
+
 struct DeviceState {
-    libusb_device_handle* handle = nullptr;
-    libusb_device* device = nullptr;
-    libusb_transfer* transfer = nullptr;
+    // What the game thread reads, written only by the USB thread: `connected` and `accepts_commands` when
+    // the pad comes or goes, `last_button_state` and `events` whenever the state changes (on a report, when
+    // a held release expires, or on disconnect), and `stats` on every report. They're on cache lines apart
+    // from the USB thread's working state below, so polling a pad only contends with those writes.
+    alignas(64) std::atomic<bool> connected{false};
+    std::atomic<bool> accepts_commands{false}; // Has an OUT transfer for lights
+    std::atomic<uint16_t> last_button_state{0};
+    SPSCQueue<LowLatencyDanceGameSDK::InputEvent, LowLatencyDanceGameSDK::EVENT_QUEUE_CAPACITY> events;
+    DeviceStats stats;
+    
+    // Written by the USB thread as the state changes, and read by any number of game threads. On cache lines
+    // of its own, apart from the state polled above and the USB thread's working state below.
+    alignas(64) PanelHistory presses;
+    
+    // Everything below belongs to the USB thread
+    alignas(64) PadConnection* connection = nullptr;
+    std::vector<InputTransfer> transfers;
+    std::vector<unsigned char> transfer_buffers; // transfers.size() * packet_size bytes
+    int packet_size = 0;
+    int next_transfer = 0;     // Ring index of the oldest outstanding transfer
+    int pending_transfers = 0; // Transfers currently owned by the transport
+    uint8_t hid_interface = 0;
     uint8_t interrupt_in_endpoint = 0;
     uint8_t interrupt_out_endpoint = 0;
-    uint8_t hid_interface = 0;
-    bool connected = false;
     uint16_t nonatomic_last_button_state = 0;
-    std::atomic<uint16_t> last_button_state{0};
-    unsigned char buffer[65];
-    DancePadAdapterPlayer player;
+    uint64_t event_sequence = 0;
+    uint64_t last_change_ns = 0;
+    DebounceFilter debounce;
+    int player = 0; // Index of this slot
+    DancePadAdapterPlayer preferred_player = DancePadAdapterPlayerUnknown; // What the pad itself reported
     struct DancePadAdapter adapter;
+    std::unique_ptr<DancePadAdapterLayout> hid_layout; // Backs adapter.layout for pads set up from their report descriptor
+    std::vector<uint8_t> hid_descriptor; // What hid_layout was built from, kept only for the session recording
     void* impl;
+
+    // Where the pad was last attached. Kept after a disconnect so a replugged pad finds its slot again.
+    uint8_t bus_number = 0;
+    uint8_t device_address = 0;
+    uint8_t port_path[8] = {0};
+    int port_path_length = 0;
+    
+    // Set up from the device cache rather than by asking the pad. Its endpoints are unconfirmed until its
+    // first report, and `checking_cache` stays set until then and until player_check is done with.
+    int cached_slot = -1;
+    bool checking_cache = false;
+    bool cache_unconfirmed = false;
+    PlayerCheck player_check = PlayerCheck::None;
+    uint64_t player_check_deadline_ns = 0;
+
+    // Lights output. `lights` is written by the game thread, the rest belongs to the USB thread.
+    TripleBuffer<LowLatencyDanceGameSDK::LightsFrame> lights;
+    std::atomic<bool> output_waiting{false}; // USB thread is idle until a new frame arrives
+    PadTransfer* output_transfer = nullptr;
+    std::vector<unsigned char> output_buffer;
+    int output_packet_size = 0;
+    const LowLatencyDanceGameSDK::LightsFrame* output_frame = nullptr; // Frame being sent; owned by `lights`, `repeating` or `queued_command`
+    OutputKind output_kind = OutputKind::Lights; // What output_frame is, or was if it's done
+    int output_command = 0;           // Index of the command being sent
+    size_t output_command_start = 0;  // Where that command starts in output_frame->data
+    int output_offset = 0;            // Bytes of that command already sent
+    bool output_busy = false;         // A packet is owned by the transport
+    bool output_command_sent = false; // The packet in flight ends a command
+    bool awaiting_ack = false;
+    uint64_t ack_deadline_ns = 0;
+    uint64_t next_lights_ns = 0;
+    
+    // One-shot commands, pushed by the game thread and taken one at a time by the USB thread
+    SPSCQueue<QueuedCommand, LowLatencyDanceGameSDK::COMMAND_QUEUE_CAPACITY> commands;
+    QueuedCommand queued_command;
+    bool queued_pending = false; // queued_command's callback hasn't been called yet
+    
+    // Repeating command. The game thread writes `repeating` and reads `responses`; the USB thread picks up a
+    // new command between frames and assembles responses straight into the write side of `responses`.
+    TripleBuffer<RepeatingCommand> repeating;
+    TripleBuffer<PublishedResponse> responses;
+    const RepeatingCommand* repeating_command = nullptr; // Owned by `repeating`
+    bool response_active = false;  // Between the first and last packet of a response
+    uint64_t response_sequence = 0;
+    uint32_t repeating_serial = 0;                        // Game thread only
+    const PublishedResponse* latest_response = nullptr; // Game thread only
+
+    // Puts the slot back the way it was constructed, without destroying it, so a pointer the game thread
+    // took to it earlier still points at a live DeviceState. Only between sessions, with the USB thread
+    // stopped; `player` and `impl` are left for the caller.
+    void reset() {
+        connected.store(false, std::memory_order_relaxed);
+        accepts_commands.store(false, std::memory_order_relaxed);
+        last_button_state.store(0, std::memory_order_relaxed);
+        events.reset();
+        stats.reset();
+        presses.reset();
+
+        connection = nullptr;
+        transfers.clear();
+        transfer_buffers.clear();
+        packet_size = 0;
+        next_transfer = 0;
+        pending_transfers = 0;
+        hid_interface = 0;
+        interrupt_in_endpoint = 0;
+        interrupt_out_endpoint = 0;
+        nonatomic_last_button_state = 0;
+        event_sequence = 0;
+        last_change_ns = 0;
+        debounce.configure(0);
+        preferred_player = DancePadAdapterPlayerUnknown;
+        adapter = DancePadAdapter();
+        hid_layout.reset();
+        hid_descriptor.clear();
+
+        bus_number = 0;
+        device_address = 0;
+        memset(port_path, 0, sizeof(port_path));
+        port_path_length = 0;
+
+        cached_slot = -1;
+        checking_cache = false;
+        cache_unconfirmed = false;
+        player_check = PlayerCheck::None;
+        player_check_deadline_ns = 0;
+
+        lights.reset();
+        output_waiting.store(false, std::memory_order_relaxed);
+        output_transfer = nullptr;
+        output_buffer.clear();
+        output_packet_size = 0;
+        output_frame = nullptr;
+        output_kind = OutputKind::Lights;
+        output_command = 0;
+        output_command_start = 0;
+        output_offset = 0;
+        output_busy = false;
+        output_command_sent = false;
+        awaiting_ack = false;
+        ack_deadline_ns = 0;
+        next_lights_ns = 0;
+
+        commands.reset();
+        queued_pending = false;
+
+        repeating.reset();
+        responses.reset();
+        repeating_command = nullptr;
+        response_active = false;
+        response_sequence = 0;
+        repeating_serial = 0;
+        latest_response = nullptr;
+    }
+};
+
+// A device being opened and asked for its player on a thread of its own, so a slow or silent pad holds up
+// neither the other pads nor the event loop. Everything but `finished` belongs to the probe thread until
+// `finished` is set, and to whoever joins it after.
+struct Probe {
+    std::vector<PadDeviceInfo> listing; // Just this device, handed back to the transport once the probe is joined
+    std::unique_ptr<DeviceState> device;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+    bool succeeded = false;
+    bool rejected_hid = false; // Opened, but its report descriptor wasn't a pad's
+    bool cached = false;       // Found in the device cache, as `cache_entry`
+    DeviceCacheEntry cache_entry;
 };
 
+static bool compareUSBLocation(const DeviceState* device_a, const DeviceState* device_b) {
+    if (device_a->bus_number != device_b->bus_number) return device_a->bus_number < device_b->bus_number;
+    
+    int len_a = device_a->port_path_length;
+    int len_b = device_b->port_path_length;
+    int min_len = (len_a < len_b) ? len_a : len_b;
+    for (int i = 0; i < min_len; i++) {
+        if (device_a->port_path[i] != device_b->port_path[i]) return device_a->port_path[i] < device_b->port_path[i];
+    }
+    return len_a < len_b;
+}
+
 struct LowLatencyDanceGameSDK::Impl {
-    DeviceState* devices[MAX_PLAYERS] = {nullptr};
+    // One slot per player. All MAX_DEVICES slots are allocated by the first initialize() and never freed or
+    // reconstructed: later sessions reset them in place and slots are reused when a pad goes away, so a
+    // DeviceState the game thread found through deviceFor() always points at a live object. The game thread
+    // never sees more than device_count slots; the USB thread uses slot_count.
+    std::unique_ptr<DeviceState[]> devices;
+    int slot_count = 0;
+    std::atomic<int> device_count{0};
     InputCallback inputCallback;
     void* user_data;
+    Options options;
     bool initialized = false;
     std::atomic<bool> shutdown{false};
     std::unique_ptr<std::thread> usbThread;
+    ThreadReport thread_report = {};
+    std::unique_ptr<PadTransport> transport;
 
-    static void LIBUSB_CALL transferCallback(libusb_transfer* transfer) {
-        DeviceState* device = static_cast<DeviceState*>(transfer->user_data);
-        static_cast<Impl*>(device->impl)->handleTransferComplete(transfer);
+    // Device arrival bookkeeping; only touched on the USB thread once it is running
+    bool watching_arrivals = false;
+    std::vector<uint16_t> rejected_hid; // Bus and address of HID devices whose descriptor wasn't a pad's
+    bool rescan_requested = false;
+    uint64_t next_rescan_ns = 0;
+    
+    // Probes still running. Owned by initialize() until the USB thread starts, then by the USB thread.
+    // The mutex and condition only let initialize() sleep until they finish.
+    std::vector<std::unique_ptr<Probe>> probes;
+    std::mutex probe_mutex;
+    std::condition_variable probe_finished;
+    
+    // Loaded by initialize() when Options::device_cache_path is set, then kept up to date by whichever
+    // thread owns the probes. Probe threads get a copy of their own entry.
+    DeviceCache device_cache;
+    
+    // Set while Options::record_path is being recorded to. Fed by whichever thread owns the devices.
+    std::unique_ptr<SessionRecorder> recorder;
+    
+    // Game clock estimate, owned by the USB thread. Samples the game adds itself come in through the queue.
+    struct GameClockSample {
+        uint64_t monotonic_ns;
+        double game_time;
+    };
+    ClockEstimator game_clock;
+    SPSCQueue<GameClockSample, 64> game_clock_samples;
+    uint64_t next_game_clock_read_ns = 0;
+    
+    // Readable descriptor for games that wait on input from their own event loop. It's signalled once and
+    // then disarmed until the game acknowledges it, so a burst of input costs one write, not one per change.
+    NotifyFd input_notify;
+    std::atomic<bool> input_notify_armed{true};
+    
+    // What snapshot() reads: every slot's published state, updated by whichever thread owns the devices
+    // whenever a slot's state or connection changes. It has cache lines of its own, so taking snapshots
+    // never contends with the USB thread's working state.
+    SeqlockLatch<PlayerSnapshot, MAX_DEVICES> snapshots;
+
+    static void transferCallback(PadTransfer* transfer) {
+        InputTransfer* slot = static_cast<InputTransfer*>(transfer->user_data);
+        static_cast<Impl*>(slot->device->impl)->handleTransferComplete(slot);
     }
 
-    void handleTransferComplete(libusb_transfer* transfer) {
-        DeviceState *device = static_cast<DeviceState *>(transfer->user_data);
+    void handleTransferComplete(InputTransfer* slot) {
+        uint64_t arrival_ns = monotonicNanoseconds();
+        HotPathAuditScope audit;
+        DeviceState *device = slot->device;
+        PadTransfer* transfer = slot->transfer;
+        device->pending_transfers--;
 
-        // Assert that we are within bounds of the `Player` enum before proceeding
-        assert(device->player >= 0 && device->player < MAX_PLAYERS);
+        // Assert that we are within bounds of the device table before proceeding
+        assert(device->player >= 0 && device->player < slot_count);
 
         // Got an error; disconnect device and return without submitting another transfer
-        if (transfer->status != LIBUSB_TRANSFER_COMPLETED && transfer->status != LIBUSB_TRANSFER_TIMED_OUT) {
-            device->connected = false;
+        if (transfer->status != PadTransferStatus::Completed && transfer->status != PadTransferStatus::TimedOut) {
+            if (transfer->status != PadTransferStatus::Cancelled) {
+                DeviceStats::increment(device->stats.errors);
+            }
+            setConnected(device, false);
             return;
         }
 
+        // Completions on one endpoint should arrive in submission order, but hold any early ones back
+        // so reports are always parsed in the order the pad sent them
+        slot->completed = true;
+        int depth = static_cast<int>(device->transfers.size());
+        while (device->transfers[device->next_transfer].completed) {
+            InputTransfer* next = &device->transfers[device->next_transfer];
+            next->completed = false;
+            device->next_transfer = (device->next_transfer + 1) % depth;
+
+            // A timeout without data carries no report, so it must not be parsed as "nothing pressed"
+            if (next->transfer->status == PadTransferStatus::Completed || next->transfer->actual_length > 0) {
+                hotPathAuditReport();
+                recordReportTiming(device, arrival_ns);
+                handleReport(device, next->transfer->buffer, next->transfer->actual_length, arrival_ns);
+                if (recorder) {
+                    recorder->recordReport(device->player, next->transfer->buffer, next->transfer->actual_length,
+                                           device->nonatomic_last_button_state, arrival_ns);
+                }
+            } else {
+                DeviceStats::increment(device->stats.timeouts);
+            }
+
+            if (shutdown || !device->connected) {
+                continue;
+            }
+
+            // Put the transfer straight back in the queue; the remaining ones keep the endpoint busy meanwhile.
+            // A slot that can't be resubmitted would never complete and so hold up the ring for good, so the
+            // pad is dropped instead: the rest drain, then it's released and picked up again by a rescan.
+            if (transport->submitTransfer(next->transfer)) {
+                device->pending_transfers++;
+            } else {
+                setConnected(device, false);
+            }
+        }
+    }
+
+    static void recordReportTiming(DeviceState* device, uint64_t arrival_ns) {
+        DeviceStats& stats = device->stats;
+        DeviceStats::increment(stats.reports);
+        if (stats.last_report_ns != 0) {
+            uint64_t interval = arrival_ns - stats.last_report_ns;
+            stats.report_interval.record(interval);
+            if (stats.last_interval_ns != 0) {
+                stats.completion_jitter.record(interval > stats.last_interval_ns ? interval - stats.last_interval_ns
+                                                                                : stats.last_interval_ns - interval);
+            }
+            stats.last_interval_ns = interval;
+        }
+        stats.last_report_ns = arrival_ns;
+    }
+
+    void handleReport(DeviceState* device, uint8_t* report, int length, uint64_t arrival_ns) {
+        if (device->checking_cache) {
+            checkCachedDevice(device, report, length, arrival_ns);
+        }
+        
+        // Pads with a command protocol interleave command traffic with input on the same endpoint
+        if (device->adapter.classify_report) {
+            const uint8_t* payload = nullptr;
+            int payload_length = 0;
+            DancePadAdapterReportFlags flags = device->adapter.classify_report(report, length, &payload, &payload_length);
+            if (payload_length > 0 || (flags & (DancePadAdapterReportResponseStart | DancePadAdapterReportResponseEnd))) {
+                collectResponse(device, flags, payload, payload_length, arrival_ns);
+            }
+            if (flags & DancePadAdapterReportCommandFinished) {
+                if (device->output_kind == OutputKind::Queued) {
+                    finishQueuedCommand(device, true, nullptr);
+                }
+                device->awaiting_ack = false;
+                pumpOutput(device, arrival_ns);
+            }
+            if (!(flags & DancePadAdapterReportInput)) {
+                return;
+            }
+        }
+        if (device->adapter.layout && !dance_pad_layout_matches(device->adapter.layout, report, length)) {
+            return;
+        }
+        
         // Parse out the input
-        uint16_t new_state = device->adapter.input_converter(device->buffer, transfer->actual_length);
+        uint64_t convert_start_ns = monotonicNanoseconds();
+        uint16_t new_state = dance_pad_adapter_convert(&device->adapter, report, length);
+        device->stats.converter_time.record(monotonicNanoseconds() - convert_start_ns);
+        publishState(device, device->debounce.filter(new_state, arrival_ns), arrival_ns);
+    }
+
+    // A pad opened from the device cache proves its endpoints with its first report, and says whether its
+    // player is still what the cache thought by answering the question pumpOutput() sent it
+    void checkCachedDevice(DeviceState* device, const uint8_t* report, int length, uint64_t arrival_ns) {
+        device->cache_unconfirmed = false;
+        if (device->player_check == PlayerCheck::Sent) {
+            DancePadAdapterPlayer player = device->adapter.player_reply(report, length);
+            if (player != DancePadAdapterPlayerUnknown) {
+                device->player_check = PlayerCheck::None;
+                if (player != device->preferred_player) {
+                    // The pad's setting changed since it was cached, so the next start should go by it
+                    device->preferred_player = player;
+                    rememberDevice(device, false);
+                }
+            } else if (arrival_ns >= device->player_check_deadline_ns) {
+                device->player_check = PlayerCheck::None; // Keep what the cache said
+            }
+        }
+        device->checking_cache = device->player_check != PlayerCheck::None;
+    }
 
+    // Assembles a command response from its packets. Answers to the repeating command are published and
+    // answers to a queued command go to its callback; anything else was for lights and needs nothing more.
+    void collectResponse(DeviceState* device, DancePadAdapterReportFlags flags, const uint8_t* payload,
+                         int payload_length, uint64_t arrival_ns) {
+        PublishedResponse& published = device->responses.writeBuffer();
+        CommandResponse& response = published.response;
+        if (flags & DancePadAdapterReportResponseStart) {
+            device->response_active = true;
+            response.size = 0;
+        }
+        if (!device->response_active) {
+            return;
+        }
+        
+        size_t size = static_cast<size_t>(payload_length);
+        if (size > CommandResponse::MAX_SIZE - response.size) {
+            size = CommandResponse::MAX_SIZE - response.size;
+        }
+        if (size > 0) {
+            memcpy(&response.data[response.size], payload, size);
+            response.size += size;
+        }
+        if (!(flags & DancePadAdapterReportResponseEnd)) {
+            return;
+        }
+        
+        device->response_active = false;
+        if (device->output_kind == OutputKind::Queued) {
+            finishQueuedCommand(device, true, &response);
+            return;
+        }
+        const RepeatingCommand* command = device->repeating_command;
+        if (!command || device->output_kind != OutputKind::Repeating) {
+            return;
+        }
+        response.timestamp_ns = arrival_ns;
+        response.sequence = device->response_sequence++;
+        published.serial = command->serial;
+        device->responses.publish();
+        if (command->callback) {
+            HotPathAuditPause audit_pause;
+            command->callback(static_cast<Player>(device->player), command->user_data);
+        }
+    }
+
+    // Calls a queued command's callback, once. `response` is null if the pad only acknowledged it.
+    void finishQueuedCommand(DeviceState* device, bool sent, const CommandResponse* response) {
+        if (!device->queued_pending) {
+            return;
+        }
+        device->queued_pending = false;
+        if (device->queued_command.callback) {
+            HotPathAuditPause audit_pause;
+            device->queued_command.callback(static_cast<Player>(device->player), sent, response,
+                                            device->queued_command.user_data);
+        }
+    }
+
+    void publishSnapshot(DeviceState* device, uint16_t button_state, uint64_t last_change_ns) {
+        PlayerSnapshot entry = {};
+        entry.button_state = button_state;
+        entry.connected = device->connected.load(std::memory_order_relaxed);
+        entry.sequence = device->event_sequence;
+        entry.last_change_ns = last_change_ns;
+        snapshots.publish(device->player, entry);
+        device->last_change_ns = last_change_ns;
+    }
+    
+    void setConnected(DeviceState* device, bool connected) {
+        if (device->connected.load(std::memory_order_relaxed) != connected) {
+            device->connected = connected;
+            publishSnapshot(device, device->nonatomic_last_button_state, device->last_change_ns);
+        }
+    }
+    
+    void publishState(DeviceState* device, uint16_t new_state, uint64_t arrival_ns) {
         // If the input state is different from the last input state we received, call the callback
         if (new_state != device->nonatomic_last_button_state) {
+            device->presses.record(device->nonatomic_last_button_state, new_state, arrival_ns);
             device->last_button_state = new_state;
+            // A full queue drops the event; the consumer sees it as a gap in `sequence`
+            InputEvent event = {new_state, arrival_ns, device->event_sequence++, 0.0, game_clock.valid()};
+            if (event.has_game_time) {
+                event.game_time = game_clock.toGameTime(arrival_ns);
+            }
+            if (!device->events.push(event)) {
+                DeviceStats::increment(device->stats.dropped_events);
+            }
+            publishSnapshot(device, new_state, arrival_ns);
+            // The exchange pairs with the one in acknowledgeInput(): whichever comes second sees the other's side
+            if (input_notify_armed.exchange(false, std::memory_order_acq_rel)) {
+                HotPathAuditNotify audit_notify; // Budgeted on its own, see HotPathAudit.h
+                input_notify.signal();
+            }
             if (inputCallback) {
+                HotPathAuditPause audit_pause; // The user's code isn't ours to audit
+                uint64_t callback_start_ns = monotonicNanoseconds();
                 inputCallback(static_cast<Player>(device->player), new_state, user_data);
+                device->stats.callback_time.record(monotonicNanoseconds() - callback_start_ns);
             }
             device->nonatomic_last_button_state = new_state;
         }
+    }
+
+    static void outputTransferCallback(PadTransfer* transfer) {
+        DeviceState* device = static_cast<DeviceState*>(transfer->user_data);
+        static_cast<Impl*>(device->impl)->handleOutputComplete(device);
+    }
 
-        if (shutdown) {
+    void handleOutputComplete(DeviceState* device) {
+        uint64_t now = monotonicNanoseconds();
+        device->pending_transfers--;
+        device->output_busy = false;
+        
+        // Drop the rest of a frame that failed to send; the next one starts a fresh command anyway
+        if (device->output_transfer->status != PadTransferStatus::Completed) {
+            if (device->output_kind == OutputKind::Queued) {
+                finishQueuedCommand(device, false, nullptr);
+            }
+            device->output_frame = nullptr;
+            device->output_command_sent = false;
             return;
         }
-
-        // If we reach this point, immediately submit a new transfer
-        libusb_submit_transfer(transfer);
+        
+        if (device->output_command_sent) {
+            device->output_command_sent = false;
+            device->awaiting_ack = true;
+            device->ack_deadline_ns = now + 100000000; // Don't stall lights forever if an ack goes missing
+        }
+        pumpOutput(device, now);
     }
 
-    bool setupDevice(libusb_device_handle* handle, DeviceState* device) {
-        struct libusb_config_descriptor *config;
-        libusb_get_active_config_descriptor(libusb_get_device(handle), &config);
-        
-        int hid_interface = -1;
-        int hid_interface_index = -1;
-        for (int i = 0; i < config->bNumInterfaces; i++) {
-            const struct libusb_interface_descriptor *intf = &config->interface[i].altsetting[0];
-            if (intf->bInterfaceClass == 3) {
-                hid_interface = intf->bInterfaceNumber;
-                hid_interface_index = i;
-                break;
+    // Sends the next lights or repeating command packet if the pad is ready for one. Output has its own transfer
+    // on the OUT endpoint and only runs after input has been handled, so commands never hold up an input report.
+    void pumpOutput(DeviceState* device, uint64_t now) {
+        if (!device->output_transfer || device->output_busy || shutdown || !device->connected) {
+            return;
+        }
+        if (device->awaiting_ack) {
+            if (now < device->ack_deadline_ns) {
+                return;
             }
+            device->awaiting_ack = false;
         }
         
-        if (hid_interface == -1) {
-            libusb_free_config_descriptor(config);
-            return false;
+        bool between_frames = !device->output_frame || device->output_command >= device->output_frame->command_count;
+        if (between_frames && device->player_check == PlayerCheck::Due) {
+            sendPlayerQuery(device, now);
+            return;
         }
         
-        if (libusb_kernel_driver_active(handle, hid_interface) == 1) {
-            if (libusb_detach_kernel_driver(handle, hid_interface) != 0) {
-                libusb_free_config_descriptor(config);
-                return false;
+        if (between_frames) {
+            device->output_frame = nextOutputFrame(device, now);
+            if (!device->output_frame) {
+                return;
             }
+            device->output_command = 0;
+            device->output_command_start = 0;
+            device->output_offset = 0;
         }
         
-        if (libusb_claim_interface(handle, hid_interface) < 0) {
-            libusb_free_config_descriptor(config);
-            return false;
+        const LightsFrame* frame = device->output_frame;
+        int length = frame->command_size[device->output_command];
+        int consumed = device->adapter.packetize_command(
+            &frame->data[device->output_command_start], length, device->output_offset,
+            device->output_buffer.data(), device->output_packet_size);
+        if (consumed <= 0) {
+            if (device->output_kind == OutputKind::Queued) {
+                finishQueuedCommand(device, false, nullptr);
+            }
+            device->output_frame = nullptr;
+            return;
         }
         
-        uint8_t interrupt_in_endpoint = 0;
-        uint8_t interrupt_out_endpoint = 0;
+        device->output_offset += consumed;
+        if (device->output_offset >= length) {
+            device->output_command_sent = true;
+            device->output_command_start += length;
+            device->output_command++;
+            device->output_offset = 0;
+        }
         
-        for (int i = 0; i < config->interface[hid_interface_index].altsetting[0].bNumEndpoints; i++) {
-            const struct libusb_endpoint_descriptor *ep = &config->interface[hid_interface_index].altsetting[0].endpoint[i];
-            
-            bool is_interrupt = (ep->bmAttributes & 0x03) == 0x03;
-            bool is_input = (ep->bEndpointAddress & 0x80) != 0;
-            bool is_output = (ep->bEndpointAddress & 0x80) == 0;
-            
-            if (is_interrupt && is_input && interrupt_in_endpoint == 0) {
-                interrupt_in_endpoint = ep->bEndpointAddress;
+        if (!transport->submitTransfer(device->output_transfer)) {
+            if (device->output_kind == OutputKind::Queued) {
+                finishQueuedCommand(device, false, nullptr);
+            }
+            device->output_frame = nullptr;
+            device->output_command_sent = false;
+            return;
+        }
+        device->output_busy = true;
+        device->pending_transfers++;
+    }
+
+    // Asks a pad opened from the device cache for its player, as a packet of its own that isn't acked
+    void sendPlayerQuery(DeviceState* device, uint64_t now) {
+        device->player_check = PlayerCheck::None;
+        int length = device->adapter.player_query(device->output_buffer.data(), device->output_packet_size);
+        if (length <= 0 || !transport->submitTransfer(device->output_transfer)) {
+            return;
+        }
+        device->output_busy = true;
+        device->pending_transfers++;
+        device->player_check = PlayerCheck::Sent;
+        device->player_check_deadline_ns = now + 1000000000;
+    }
+
+    // Lights go first whenever they're due, then queued commands; the repeating command fills the time in between
+    const LightsFrame* nextOutputFrame(DeviceState* device, uint64_t now) {
+        // A queued command the pad never acked or answered counts as sent once we give up waiting
+        finishQueuedCommand(device, true, nullptr);
+        
+        if (device->repeating.hasFresh()) {
+            device->repeating_command = device->repeating.consume();
+            device->response_sequence = 0;
+            if (device->repeating_command->frame.command_count == 0) {
+                device->repeating_command = nullptr;
             }
-            if (is_interrupt && is_output && interrupt_out_endpoint == 0) {
-                interrupt_out_endpoint = ep->bEndpointAddress;
+        }
+        
+        if (now >= device->next_lights_ns) {
+            // Only the newest frame is ever taken; anything older was overwritten while we were busy
+            device->output_waiting = true;
+            if (const LightsFrame* frame = device->lights.consume()) {
+                device->output_waiting = false;
+                device->output_kind = OutputKind::Lights;
+                device->next_lights_ns = now + static_cast<uint64_t>(options.lights_min_interval_us) * 1000;
+                return frame;
             }
         }
         
-        libusb_free_config_descriptor(config);
+        if (device->commands.popInto(&device->queued_command, 1) == 1) {
+            device->output_waiting = false;
+            device->output_kind = OutputKind::Queued;
+            device->queued_pending = true;
+            return &device->queued_command.frame;
+        }
         
-        if (interrupt_in_endpoint == 0) {
-            libusb_release_interface(handle, hid_interface);
+        if (!device->repeating_command) {
+            return nullptr;
+        }
+        device->output_waiting = false;
+        device->output_kind = OutputKind::Repeating;
+        return &device->repeating_command->frame;
+    }
+
+    // Lets an adapter's get_player run its blocking probe transfers through whichever transport opened the pad
+    static int adapterInterruptTransfer(void* context, uint8_t endpoint, uint8_t* data, int length, int* transferred, unsigned int timeout) {
+        DeviceState* device = static_cast<DeviceState*>(context);
+        Impl* impl = static_cast<Impl*>(device->impl);
+        return impl->transport->interruptTransfer(device->connection, endpoint, data, length, transferred, timeout);
+    }
+
+    static uint16_t locationKey(const PadDeviceInfo& info) {
+        return static_cast<uint16_t>((info.bus_number << 8) | info.device_address);
+    }
+
+    // Finds the adapter for a device, or says whether it's worth opening to read its report descriptor
+    bool isPadCandidate(const PadDeviceInfo& info, struct DancePadAdapter* adapter) {
+        *adapter = dance_pad_adapter_for(info.vendor_id, info.product_id);
+        if (adapter->is_valid) {
+            return true;
+        }
+        if (!options.generic_hid || !info.hid_candidate) {
+            return false;
+        }
+        // Addresses aren't reused until the device is replugged, so a rejected device is never reopened
+        for (uint16_t key : rejected_hid) {
+            if (key == locationKey(info)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Builds an adapter from the pad's HID report descriptor
+    bool setupHIDAdapter(const PadDeviceInfo& info, DeviceState* device, const uint8_t* descriptor, int length) {
+        if (length <= 0) {
             return false;
         }
         
-        device->handle = handle;
-        device->interrupt_in_endpoint = interrupt_in_endpoint;
-        device->interrupt_out_endpoint = interrupt_out_endpoint;
-        device->hid_interface = hid_interface;
-        device->player = device->adapter.get_player(handle, interrupt_in_endpoint, interrupt_out_endpoint);
-        device->connected = true;
-        device->impl = this;
+        std::unique_ptr<DancePadAdapterLayout> layout(new DancePadAdapterLayout());
+        if (!hid_pad_build_layout(descriptor, length, layout.get())) {
+            return false;
+        }
+        device->adapter = hid_pad_adapter(info.vendor_id, info.product_id, layout.get());
+        device->hid_layout = std::move(layout);
+        if (options.record_path) {
+            device->hid_descriptor.assign(descriptor, descriptor + length);
+        }
+        return true;
+    }
+
+    // Runs on a probe thread, so it mustn't touch anything but `device`. A pad with a `cached` entry is
+    // opened the way the cache says and believed about its player; if the cached interface can't be
+    // claimed, it's set up from scratch instead.
+    bool setupDevice(const PadDeviceInfo& info, DeviceState* device, bool* rejected_hid, const DeviceCacheEntry* cached) {
+        // A device with no adapter is judged by its report descriptor before it's opened, if the OS has a
+        // copy, since opening it takes it from the OS's own driver (a keyboard or mouse would stop working)
+        uint8_t descriptor[4096];
+        int descriptor_length = 0;
+        if (!device->adapter.is_valid) {
+            descriptor_length = transport->readReportDescriptor(info, descriptor, sizeof(descriptor));
+            if (descriptor_length > 0 && !setupHIDAdapter(info, device, descriptor, descriptor_length)) {
+                *rejected_hid = true;
+                return false;
+            }
+        }
         
-        device->transfer = libusb_alloc_transfer(0);
-        if (!device->transfer) {
-            libusb_release_interface(handle, hid_interface);
+        PadConnection* connection = transport->open(info, cached ? &cached->layout : nullptr);
+        if (!connection && cached) {
+            cached = nullptr;
+            connection = transport->open(info, nullptr);
+        }
+        if (!connection) {
             return false;
         }
         
-        libusb_fill_interrupt_transfer(
-            device->transfer,
-            handle,
-            interrupt_in_endpoint,
-            device->buffer,
-            sizeof(device->buffer),
-            transferCallback,
-            device,
-            1000
-        );
-        
-        if (libusb_submit_transfer(device->transfer) < 0) {
-            libusb_free_transfer(device->transfer);
-            device->transfer = nullptr;
-            libusb_release_interface(handle, hid_interface);
+        device->connection = connection;
+        if (!device->adapter.is_valid &&
+            !setupHIDAdapter(info, device, descriptor,
+                             transport->getReportDescriptor(connection, descriptor, sizeof(descriptor)))) {
+            // Not a pad after all; give it straight back to the OS
+            transport->close(connection);
+            device->connection = nullptr;
+            *rejected_hid = true;
             return false;
         }
         
+        device->hid_interface = connection->hid_interface;
+        device->interrupt_in_endpoint = connection->interrupt_in_endpoint;
+        device->interrupt_out_endpoint = connection->interrupt_out_endpoint;
+        device->packet_size = connection->in_packet_size > 0 ? connection->in_packet_size : 64;
+        device->output_packet_size = connection->out_packet_size > 0 ? connection->out_packet_size : 64;
+        device->bus_number = info.bus_number;
+        device->device_address = info.device_address;
+        memcpy(device->port_path, info.port_path, sizeof(device->port_path));
+        device->port_path_length = info.port_path_length;
+        device->impl = this;
+        
+        if (cached) {
+            device->preferred_player = cached->preferred_player;
+            device->cached_slot = cached->slot;
+            device->cache_unconfirmed = true;
+            if (device->adapter.player_query && device->adapter.player_reply && device->interrupt_out_endpoint) {
+                device->player_check = PlayerCheck::Due;
+            }
+            device->checking_cache = true;
+            return true;
+        }
+        
+        struct DancePadAdapterIO io = { device, adapterInterruptTransfer };
+        device->player = device->adapter.get_player(&io, device->interrupt_in_endpoint, device->interrupt_out_endpoint);
+        device->preferred_player = device->player;
+        
         return true;
     }
 
-    bool discoverDevices() {
-        libusb_device **device_list;
-        ssize_t device_count = libusb_get_device_list(g_libusb_ctx, &device_list);
+    bool startTransfers(DeviceState* device) {
+        int depth = options.transfer_queue_depth > 0 ? options.transfer_queue_depth : 1;
+        device->transfers.resize(depth);
+        device->transfer_buffers.resize(static_cast<size_t>(depth) * device->packet_size);
+        if (options.thread.lock_memory) {
+            lockMemory(device->transfer_buffers.data(), device->transfer_buffers.size()); // Best effort
+        }
+        device->next_transfer = 0;
+        device->pending_transfers = 0;
         
-        if (device_count < 0) {
-            return false;
+        // Time spent unplugged isn't a report interval
+        device->stats.last_report_ns = 0;
+        device->stats.last_interval_ns = 0;
+        device->debounce.configure(static_cast<uint64_t>(device->adapter.release_hold_us) * 1000);
+        
+        for (int i = 0; i < depth; i++) {
+            InputTransfer* slot = &device->transfers[i];
+            slot->device = device;
+            slot->completed = false;
+            slot->transfer = transport->allocTransfer(
+                device->connection,
+                device->interrupt_in_endpoint,
+                &device->transfer_buffers[static_cast<size_t>(i) * device->packet_size],
+                device->packet_size,
+                1000,
+                transferCallback,
+                slot
+            );
+            if (!slot->transfer) {
+                freeTransfers(device);
+                return false;
+            }
         }
         
-        int found_devices = 0;
+        // Pads that take commands get one OUT transfer for lights, which is only submitted when there's something to send
+        device->output_frame = nullptr;
+        device->output_busy = false;
+        device->output_command_sent = false;
+        device->awaiting_ack = false;
+        device->output_kind = OutputKind::Lights;
+        device->response_active = false;
+        if (device->interrupt_out_endpoint && device->adapter.packetize_command) {
+            device->output_buffer.assign(device->output_packet_size, 0);
+            device->output_transfer = transport->allocTransfer(
+                device->connection,
+                device->interrupt_out_endpoint,
+                device->output_buffer.data(),
+                device->output_packet_size,
+                1000,
+                outputTransferCallback,
+                device
+            );
+            if (!device->output_transfer) {
+                freeTransfers(device);
+                return false;
+            }
+            device->accepts_commands = true;
+        }
         
-        for (ssize_t i = 0; i < device_count && found_devices < MAX_PLAYERS; i++) {
-            struct libusb_device_descriptor desc;
-            if (libusb_get_device_descriptor(device_list[i], &desc) < 0) {
-                continue;
+        setConnected(device, true);
+        
+        // Pre-fill the whole queue so the host controller always has a pending request for this endpoint
+        for (int i = 0; i < depth; i++) {
+            if (!transport->submitTransfer(device->transfers[i].transfer)) {
+                // Transfers already submitted can't be freed until they complete, so cancel and reap them
+                setConnected(device, false);
+                for (int j = 0; j < i; j++) {
+                    transport->cancelTransfer(device->transfers[j].transfer);
+                }
+                while (device->pending_transfers > 0) {
+                    transport->handleEvents(100000000);
+                }
+                freeTransfers(device);
+                return false;
             }
-            
-            struct DancePadAdapter adapter = dance_pad_adapter_for(desc.idVendor, desc.idProduct);
-            if (!adapter.is_valid) {
-                continue;
+            device->pending_transfers++;
+        }
+        
+        return true;
+    }
+
+    void freeTransfers(DeviceState* device) {
+        for (InputTransfer& slot : device->transfers) {
+            if (slot.transfer) {
+                transport->freeTransfer(slot.transfer);
             }
-            
-            libusb_device_handle *handle;
-            if (libusb_open(device_list[i], &handle) < 0) {
+        }
+        device->transfers.clear();
+        device->transfer_buffers.clear();
+        if (device->output_transfer) {
+            device->accepts_commands = false;
+            transport->freeTransfer(device->output_transfer);
+            device->output_transfer = nullptr;
+        }
+        device->output_buffer.clear();
+        device->output_frame = nullptr;
+    }
+
+    static void runProbe(Impl* impl, Probe* probe) {
+        probe->succeeded = impl->setupDevice(probe->listing[0], probe->device.get(), &probe->rejected_hid,
+                                             probe->cached ? &probe->cache_entry : nullptr);
+        {
+            std::lock_guard<std::mutex> lock(impl->probe_mutex);
+            probe->finished.store(true, std::memory_order_release);
+        }
+        impl->probe_finished.notify_all();
+        impl->transport->interruptEvents(); // The USB thread attaches it from serviceDeviceChanges()
+    }
+
+    bool isProbing(const PadDeviceInfo& info) {
+        for (const std::unique_ptr<Probe>& probe : probes) {
+            if (probe->listing[0].bus_number == info.bus_number && probe->listing[0].device_address == info.device_address) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Starts a probe for every pad in `device_list` that isn't already attached or being probed, and
+    // hands everything else straight back to the transport
+    void startProbes(std::vector<PadDeviceInfo>& device_list) {
+        std::vector<PadDeviceInfo> unused;
+        for (PadDeviceInfo& info : device_list) {
+            struct DancePadAdapter adapter;
+            if (isAttached(info) || isProbing(info) || !isPadCandidate(info, &adapter)) {
+                unused.push_back(info);
                 continue;
             }
             
-            DeviceState* device_state = new DeviceState();
-            device_state->adapter = adapter;
-            device_state->device = device_list[i];
-            
-            if (!setupDevice(handle, device_state)) {
-                delete device_state;
-                libusb_close(handle);
+            std::unique_ptr<Probe> probe(new Probe());
+            probe->listing.push_back(info);
+            probe->device.reset(new DeviceState());
+            probe->device->adapter = adapter;
+            if (const DeviceCacheEntry* entry = options.device_cache_path ? device_cache.find(info) : nullptr) {
+                probe->cached = true;
+                probe->cache_entry = *entry;
+            }
+            probe->thread = std::thread(runProbe, this, probe.get());
+            probes.push_back(std::move(probe));
+        }
+        device_list.clear();
+        transport->releaseDevices(unused);
+    }
+
+    // Joins the probe at `index` and forgets it, returning its device if it found a pad
+    std::unique_ptr<DeviceState> takeProbe(size_t index) {
+        std::unique_ptr<Probe> probe = std::move(probes[index]);
+        probes.erase(probes.begin() + index);
+        probe->thread.join();
+        if (probe->rejected_hid) {
+            rejected_hid.push_back(locationKey(probe->listing[0]));
+        }
+        transport->releaseDevices(probe->listing);
+        
+        std::unique_ptr<DeviceState> device;
+        if (probe->succeeded) {
+            device = std::move(probe->device);
+        }
+        return device;
+    }
+
+    // Whether `field` gives every device its own slot
+    bool distinctSlots(const std::vector<std::unique_ptr<DeviceState>>& found, int DeviceState::* field) {
+        std::vector<bool> claimed(slot_count, false);
+        for (const std::unique_ptr<DeviceState>& device : found) {
+            int slot = device.get()->*field;
+            if (slot < 0 || slot >= slot_count || claimed[slot]) {
+                return false;
+            }
+            claimed[slot] = true;
+        }
+        return true;
+    }
+
+    // Records where a pad that just started streaming is and what it's like, for the next initialize().
+    // Without `keep_slot` the next start picks its slot afresh.
+    void rememberDevice(DeviceState* device, bool keep_slot = true) {
+        if (!options.device_cache_path) {
+            return;
+        }
+        DeviceCacheEntry entry;
+        entry.bus_number = device->bus_number;
+        memcpy(entry.port_path, device->port_path, sizeof(entry.port_path));
+        entry.port_path_length = device->port_path_length;
+        entry.vendor_id = device->adapter.vendor_id;
+        entry.product_id = device->adapter.product_id;
+        entry.layout.hid_interface = device->hid_interface;
+        entry.layout.interrupt_in_endpoint = device->interrupt_in_endpoint;
+        entry.layout.in_packet_size = device->packet_size;
+        entry.layout.interrupt_out_endpoint = device->interrupt_out_endpoint;
+        entry.layout.out_packet_size = device->interrupt_out_endpoint ? device->output_packet_size : 0;
+        entry.preferred_player = device->preferred_player;
+        entry.slot = keep_slot ? device->player : -1;
+        device_cache.update(entry);
+    }
+
+    void saveDeviceCache() {
+        if (options.device_cache_path && device_cache.dirty()) {
+            device_cache.save(options.device_cache_path); // Best effort; the next start just probes again
+        }
+    }
+    
+    // Notes a pad that just started streaming in the recording, with what replay needs to decode it
+    void recordAttach(DeviceState* device) {
+        if (!recorder) {
+            return;
+        }
+        RecordingAttach attach = {};
+        attach.vendor_id = device->adapter.vendor_id;
+        attach.product_id = device->adapter.product_id;
+        attach.release_hold_us = device->adapter.release_hold_us;
+        attach.descriptor_length = static_cast<uint16_t>(device->hid_descriptor.size());
+        attach.bus_number = device->bus_number;
+        attach.port_path_length = static_cast<uint8_t>(device->port_path_length);
+        memcpy(attach.port_path, device->port_path, sizeof(attach.port_path));
+        recorder->recordAttach(device->player, attach, device->hid_descriptor.data(), monotonicNanoseconds());
+    }
+
+    // Set up from its report descriptor rather than by an adapter registered for it
+    static bool isGenericHID(const DeviceState* device) {
+        return device->hid_layout != nullptr;
+    }
+
+    bool discoverDevices() {
+        std::vector<PadDeviceInfo> device_list;
+        if (!transport->listDevices(device_list)) {
+            return false;
+        }
+        startProbes(device_list);
+        
+        // Wait for every probe, but only up to the deadline; any still going are left to the USB thread
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.startup_timeout_ms);
+        {
+            std::unique_lock<std::mutex> lock(probe_mutex);
+            probe_finished.wait_until(lock, deadline, [this] {
+                for (const std::unique_ptr<Probe>& probe : probes) {
+                    if (!probe->finished.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+        
+        // Which slot each pad gets depends on all of the pads that answered in time. Pads with an adapter of
+        // their own go first, so a generic HID device never takes a slot a real pad could have had.
+        std::vector<std::unique_ptr<DeviceState>> found;
+        for (size_t i = 0; i < probes.size();) {
+            if (!probes[i]->finished.load(std::memory_order_acquire)) {
+                i++;
                 continue;
             }
-            
-            // Just place devices in order found - will sort later if needed
-            if (found_devices < MAX_PLAYERS) {
-                devices[found_devices] = device_state;
+            std::unique_ptr<DeviceState> device = takeProbe(i);
+            if (device) {
+                found.push_back(std::move(device));
+            }
+        }
+        std::stable_sort(found.begin(), found.end(),
+                         [](const std::unique_ptr<DeviceState>& a, const std::unique_ptr<DeviceState>& b) {
+                             return !isGenericHID(a.get()) && isGenericHID(b.get());
+                         });
+        while (static_cast<int>(found.size()) > slot_count) {
+            transport->close(found.back()->connection);
+            found.pop_back();
+        }
+        
+        // Put every pad back in the slot the device cache has for it if all of them are in there, else use
+        // each pad's own player setting if they all have one; if neither gives every pad its own slot (some
+        // are unknown, or two want the same player) fall back to USB port order for all of them
+        int DeviceState::* slot_field = nullptr;
+        if (distinctSlots(found, &DeviceState::cached_slot)) {
+            slot_field = &DeviceState::cached_slot;
+        } else if (distinctSlots(found, &DeviceState::preferred_player)) {
+            slot_field = &DeviceState::preferred_player;
+        } else {
+            std::stable_sort(found.begin(), found.end(),
+                             [](const std::unique_ptr<DeviceState>& a, const std::unique_ptr<DeviceState>& b) {
+                                 if (isGenericHID(a.get()) != isGenericHID(b.get())) {
+                                     return isGenericHID(b.get());
+                                 }
+                                 return compareUSBLocation(a.get(), b.get());
+                             });
+        }
+        
+        // Move each pad into its slot and start streaming input
+        int found_devices = 0;
+        for (size_t i = 0; i < found.size(); i++) {
+            DeviceState* slot = &devices[slot_field ? found[i].get()->*slot_field : static_cast<int>(i)];
+            moveConnection(found[i].get(), slot);
+            if (startTransfers(slot)) {
+                rememberDevice(slot);
+                recordAttach(slot);
                 found_devices++;
             } else {
-                delete device_state;
-                libusb_close(handle);
+                releaseDevice(slot);
+            }
+        }
+        
+        // A pad that's slow to answer still counts; it gets a slot when its probe finishes
+        return found_devices > 0 || !probes.empty();
+    }
+
+    // Waits out every probe still running, closing whatever they opened
+    void finishProbes() {
+        while (!probes.empty()) {
+            std::unique_ptr<DeviceState> device = takeProbe(0);
+            if (device) {
+                transport->close(device->connection);
+            }
+        }
+    }
+
+    // Frees a pad's USB resources once all of its transfers have been reaped. The slot keeps its
+    // location so the pad can be reattached to it.
+    void releaseDevice(DeviceState* device) {
+        setConnected(device, false);
+        freeTransfers(device);
+        if (device->connection) {
+            transport->close(device->connection);
+            device->connection = nullptr;
+            if (recorder) {
+                recorder->recordDetach(device->player, monotonicNanoseconds());
             }
         }
         
-        // Handle single device case first
-        if (found_devices == 1) {
-            DeviceState* single_device = devices[0];
-            if (single_device->player == DancePadAdapterPlayer2) {
-                // Move P2 preference to correct slot
-                devices[1] = single_device;
-                devices[0] = nullptr;
+        // Commands can't be sent anymore, so tell their senders now rather than on some later replug
+        finishQueuedCommand(device, false, nullptr);
+        while (device->commands.popInto(&device->queued_command, 1) == 1) {
+            device->queued_pending = true;
+            finishQueuedCommand(device, false, nullptr);
+        }
+        
+        // Don't leave panels stuck down when the cable goes
+        device->debounce.reset();
+        if (device->nonatomic_last_button_state != 0 && !shutdown) {
+            publishState(device, 0, monotonicNanoseconds());
+        }
+    }
+
+    static void moveConnection(DeviceState* from, DeviceState* to) {
+        to->connection = from->connection;
+        to->interrupt_in_endpoint = from->interrupt_in_endpoint;
+        to->interrupt_out_endpoint = from->interrupt_out_endpoint;
+        to->packet_size = from->packet_size;
+        to->output_packet_size = from->output_packet_size;
+        to->adapter = from->adapter;
+        to->hid_layout = std::move(from->hid_layout);
+        to->hid_descriptor = std::move(from->hid_descriptor);
+        to->hid_interface = from->hid_interface;
+        to->preferred_player = from->preferred_player;
+        to->cached_slot = from->cached_slot;
+        to->checking_cache = from->checking_cache;
+        to->cache_unconfirmed = from->cache_unconfirmed;
+        to->player_check = from->player_check;
+        to->bus_number = from->bus_number;
+        to->device_address = from->device_address;
+        memcpy(to->port_path, from->port_path, sizeof(to->port_path));
+        to->port_path_length = from->port_path_length;
+        from->connection = nullptr;
+    }
+
+    bool hasFreeSlot() {
+        for (int i = 0; i < slot_count; i++) {
+            if (!devices[i].connection) {
+                return true;
             }
-            // If P1 or Unknown, leave at slot 0
-        } else if (devices[0] && devices[1]) {
-            // Sort devices: if either is unknown, or if both are set to the same player, use USB port order; otherwise use pad preference
-            bool has_unknown = (devices[0]->player == DancePadAdapterPlayerUnknown || 
-                               devices[1]->player == DancePadAdapterPlayerUnknown);
-            bool is_same_player = devices[0]->player == devices[1]->player;
+        }
+        return false;
+    }
+
+    bool isAttached(const PadDeviceInfo& info) {
+        for (int i = 0; i < slot_count; i++) {
+            if (devices[i].connection && devices[i].bus_number == info.bus_number && devices[i].device_address == info.device_address) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-            bool swapped_player_preferences = devices[0]->player == DancePadAdapterPlayer2 && devices[1]->player == DancePadAdapterPlayer1;
-            bool swapped_usb_preferences = (has_unknown || is_same_player) && !compareUSBLocation(devices[0]->device, devices[1]->device);
+    // Picks the free slot a newly arrived pad belongs in: the one last used on the same USB port (this
+    // session or, going by the device cache, the last one), then the one matching the pad's own player
+    // setting, then one that has never had a pad
+    DeviceState* slotForArrival(DeviceState* probe) {
+        DeviceState* best = nullptr;
+        int best_score = -1;
+        for (int i = 0; i < slot_count; i++) {
+            DeviceState* slot = &devices[i];
+            if (slot->connection) {
+                continue;
+            }
+            
+            int score = 0;
+            if (slot->port_path_length > 0 && slot->bus_number == probe->bus_number &&
+                slot->port_path_length == probe->port_path_length &&
+                memcmp(slot->port_path, probe->port_path, slot->port_path_length) == 0) {
+                score = 3;
+            } else if (probe->cached_slot == i) {
+                score = 3;
+            } else if (probe->preferred_player == i) {
+                score = 2;
+            } else if (slot->port_path_length == 0) {
+                score = 1;
+            }
             
-            bool should_swap = swapped_player_preferences || swapped_usb_preferences;
+            if (score > best_score) {
+                best = slot;
+                best_score = score;
+            }
+        }
+        return best;
+    }
+
+    // Puts pads whose probes have finished into the slots they belong in
+    void attachProbedDevices() {
+        for (size_t i = 0; i < probes.size();) {
+            if (!probes[i]->finished.load(std::memory_order_acquire)) {
+                i++;
+                continue;
+            }
+            std::unique_ptr<DeviceState> device = takeProbe(i);
+            if (!device) {
+                continue;
+            }
+            if (!hasFreeSlot()) {
+                transport->close(device->connection);
+                continue;
+            }
             
-            if (should_swap) {
-                DeviceState* temp = devices[0];
-                devices[0] = devices[1];
-                devices[1] = temp;
+            DeviceState* slot = slotForArrival(device.get());
+            moveConnection(device.get(), slot);
+            if (startTransfers(slot)) {
+                rememberDevice(slot);
+                recordAttach(slot);
+            } else {
+                releaseDevice(slot);
             }
         }
+    }
+
+    void rescanDevices() {
+        std::vector<PadDeviceInfo> device_list;
+        if (!transport->listDevices(device_list)) {
+            return;
+        }
+        startProbes(device_list);
+    }
+
+    // Runs between event loop iterations: tears down pads that errored out and attaches new arrivals
+    void serviceDeviceChanges() {
+        if (!probes.empty()) {
+            attachProbedDevices();
+        }
         
-        // Assign final player values based on array position
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (devices[i]) {
-                devices[i]->player = static_cast<DancePadAdapterPlayer>(i);
-                devices[i]->device = nullptr;  // Invalidate after use
+        for (int i = 0; i < slot_count; i++) {
+            DeviceState* device = &devices[i];
+            if (!device->connected && device->connection && device->pending_transfers == 0) {
+                // A pad opened from the cache that failed before its first report may have been opened wrong
+                if (device->cache_unconfirmed) {
+                    device_cache.forget(device->bus_number, device->port_path, device->port_path_length);
+                }
+                releaseDevice(device);
+                // The pad may still be plugged in after a transient error, which hotplug won't report
+                rescan_requested = true;
             }
         }
         
-        libusb_free_device_list(device_list, 1);
-        return found_devices > 0;
+        // Arrivals can't be probed from inside the transport's callback, so they're picked up by a scan here
+        bool arrived = transport->takeArrivals();
+        if (!hasFreeSlot()) {
+            return;
+        }
+        if (arrived) {
+            rescanDevices();
+            return;
+        }
+        
+        if (options.rescan_interval_ms <= 0 || !(rescan_requested || !watching_arrivals)) {
+            return;
+        }
+        uint64_t now = monotonicNanoseconds();
+        if (now >= next_rescan_ns) {
+            next_rescan_ns = now + static_cast<uint64_t>(options.rescan_interval_ms) * 1000000;
+            rescan_requested = false;
+            rescanDevices();
+        }
     }
 
+    // Slots aren't freed here: the game thread may still be holding one, so they're reset by the next
+    // initialize() instead
     void cleanupDevices() {
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (devices[i]) {
-                if (devices[i]->transfer) {
-                    libusb_free_transfer(devices[i]->transfer);
-                }
-                if (devices[i]->handle) {
-                    libusb_release_interface(devices[i]->handle, devices[i]->hid_interface);
-                    libusb_close(devices[i]->handle);
+        for (int i = 0; i < slot_count; i++) {
+            releaseDevice(&devices[i]);
+        }
+    }
+
+    bool hasPendingTransfers() {
+        for (int i = 0; i < slot_count; i++) {
+            if (devices[i].pending_transfers > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void cancelTransfers() {
+        for (int i = 0; i < slot_count; i++) {
+            for (InputTransfer& slot : devices[i].transfers) {
+                transport->cancelTransfer(slot.transfer);
+            }
+            if (devices[i].output_transfer && devices[i].output_busy) {
+                transport->cancelTransfer(devices[i].output_transfer);
+            }
+        }
+    }
+
+    // Gives initialize() `count` empty slots, allocating the table the first time and resetting it in place
+    // after that
+    void resetDevices(int count) {
+        if (!devices) {
+            devices.reset(new DeviceState[MAX_DEVICES]);
+        }
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            devices[i].reset();
+        }
+        for (int i = 0; i < count; i++) {
+            devices[i].player = i;
+            devices[i].impl = this;
+        }
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            snapshots.publish(i, PlayerSnapshot());
+        }
+        slot_count = count;
+    }
+
+    // The slot the game thread should use for `player`, or nullptr outside the current session
+    DeviceState* deviceFor(Player player) {
+        int idx = static_cast<int>(player);
+        if (idx < 0 || idx >= device_count.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &devices[idx];
+    }
+
+    // Sends any lights that were waiting on pacing or an ack, and returns how long the event loop may
+    // sleep before that needs checking again
+    uint64_t pumpAllOutput() {
+        uint64_t now = monotonicNanoseconds();
+        uint64_t wait_ns = 100000000;
+        for (int i = 0; i < slot_count; i++) {
+            DeviceState* device = &devices[i];
+            pumpOutput(device, now);
+            if (!device->output_transfer || device->output_busy) {
+                continue;
+            }
+            
+            uint64_t deadline = 0;
+            if (device->awaiting_ack) {
+                deadline = device->ack_deadline_ns;
+            } else if (device->lights.hasFresh()) {
+                deadline = device->next_lights_ns;
+            } else {
+                continue;
+            }
+            uint64_t until = deadline > now ? deadline - now : 0;
+            if (until < wait_ns) {
+                wait_ns = until;
+            }
+        }
+        return wait_ns;
+    }
+
+    // Publishes releases the debounce filter was holding back once they're due, since a pad that only
+    // reports on change may never send another report to trigger them. Returns how long until the next one.
+    uint64_t expireReleases() {
+        uint64_t now = monotonicNanoseconds();
+        uint64_t wait_ns = UINT64_MAX;
+        for (int i = 0; i < slot_count; i++) {
+            DeviceState* device = &devices[i];
+            if (!device->debounce.hasPendingReleases()) {
+                continue;
+            }
+            uint16_t previous = device->nonatomic_last_button_state;
+            publishState(device, device->debounce.expire(now), now);
+            if (recorder && device->nonatomic_last_button_state != previous) {
+                recorder->recordRelease(device->player, device->nonatomic_last_button_state, now);
+            }
+            if (device->debounce.hasPendingReleases()) {
+                uint64_t deadline = device->debounce.nextDeadline();
+                uint64_t until = deadline > now ? deadline - now : 0;
+                if (until < wait_ns) {
+                    wait_ns = until;
                 }
-                delete devices[i];
-                devices[i] = nullptr;
             }
         }
+        return wait_ns;
+    }
+
+    // Folds new game clock samples into the estimate, reading the clock itself when the game gave us a
+    // function for it. Returns how long until the next read is due.
+    uint64_t updateGameClock() {
+        GameClockSample samples[16];
+        size_t count;
+        while ((count = game_clock_samples.popInto(samples, 16)) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                game_clock.addSample(samples[i].monotonic_ns, samples[i].game_time);
+            }
+        }
+        
+        const GameClock& clock = options.game_clock;
+        if (!clock.read) {
+            return UINT64_MAX;
+        }
+        uint64_t now = monotonicNanoseconds();
+        if (now >= next_game_clock_read_ns) {
+            // Bracket the read, so the sample is taken at its midpoint however long the read took
+            uint64_t before_ns = monotonicNanoseconds();
+            double game_time = clock.read(clock.user_data);
+            uint64_t after_ns = monotonicNanoseconds();
+            game_clock.addSample(before_ns + (after_ns - before_ns) / 2, game_time);
+            
+            int interval_ms = clock.sample_interval_ms > 0 ? clock.sample_interval_ms : 1;
+            next_game_clock_read_ns = after_ns + static_cast<uint64_t>(interval_ms) * 1000000;
+            now = after_ns;
+        }
+        return next_game_clock_read_ns - now;
     }
 
-    void usbEventLoop() {
-        setThreadHighPriority();
-        int completed = 0;
+    void usbEventLoop(std::promise<ThreadReport>* started) {
+        ThreadReport report = configureThread(options.thread);
+        if (options.thread.lock_memory && report.memory_locked) {
+            // The device table holds every pad's state, event queue and stats
+            report.memory_lock_error = lockMemory(devices.get(), sizeof(DeviceState) * slot_count);
+            report.memory_locked = report.memory_lock_error == 0;
+        }
+        started->set_value(report);
+        
         while (!shutdown) {
-            libusb_handle_events_completed(g_libusb_ctx, &completed);
+            // The timeout only bounds how long device changes, paced output and held-back releases wait to
+            // be serviced; completions still wake us immediately
+            uint64_t wait_ns;
+            {
+                HotPathAuditScope audit;
+                wait_ns = pumpAllOutput();
+                uint64_t release_wait_ns = expireReleases();
+                if (release_wait_ns < wait_ns) {
+                    wait_ns = release_wait_ns;
+                }
+                uint64_t clock_wait_ns = updateGameClock();
+                if (clock_wait_ns < wait_ns) {
+                    wait_ns = clock_wait_ns;
+                }
+            }
+            transport->handleEvents(options.thread.busy_poll ? 0 : wait_ns);
+            {
+                HotPathAuditScope audit;
+                serviceDeviceChanges();
+            }
+        }
+        
+        // Reap every transfer so none is still owned by the transport when it gets freed
+        cancelTransfers();
+        while (hasPendingTransfers()) {
+            transport->handleEvents(100000000);
         }
     }
 };
@@ -323,25 +1613,88 @@ LowLatencyDanceGameSDK::~LowLatencyDanceGameSDK() {
 }
 
 bool LowLatencyDanceGameSDK::initialize(InputCallback callback, void* user_data) {
+    return initialize(callback, user_data, Options());
+}
+
+bool LowLatencyDanceGameSDK::initialize(InputCallback callback, void* user_data, const Options& options) {
     if (pImpl->initialized) {
         return true;
     }
     
     pImpl->inputCallback = callback;
     pImpl->user_data = user_data;
+    pImpl->options = options;
     pImpl->shutdown = false;
     
-    if (g_libusb_ctx == nullptr) {
-        if (libusb_init(&g_libusb_ctx) < 0) {
+    // Extra pads have to be registered before anything looks adapters up
+    if (options.adapter_mappings_path) {
+        int error_line = 0;
+        if (!dance_pad_adapter_load_mappings(options.adapter_mappings_path, &error_line)) {
             return false;
         }
     }
     
+    if (options.backend == Backend::Simulated) {
+        pImpl->transport.reset(new SimulatedTransport(options.simulated_pads, options.simulated_pad_count));
+    } else if (options.backend == Backend::Usbfs) {
+#ifdef __linux__
+        pImpl->transport.reset(new UsbfsTransport());
+#else
+        return false;
+#endif
+    } else {
+        pImpl->transport.reset(new LibusbTransport());
+    }
+    if (!pImpl->transport->start()) {
+        pImpl->transport.reset();
+        return false;
+    }
+    
+    int device_count = options.max_devices;
+    if (device_count < 1) device_count = 1;
+    if (device_count > MAX_DEVICES) device_count = MAX_DEVICES;
+    pImpl->resetDevices(device_count);
+    
+    // Estimates don't carry over between sessions; the game may be on a different clock now
+    Impl::GameClockSample stale[16];
+    while (pImpl->game_clock_samples.popInto(stale, 16) > 0) {
+    }
+    pImpl->game_clock.configure(options.game_clock.units_per_second > 0 ? options.game_clock.units_per_second : 1.0);
+    pImpl->next_game_clock_read_ns = 0;
+    
+    // Opened once and kept until the SDK goes away, so a game can register it with its event loop just once
+    pImpl->input_notify.open();
+    pImpl->input_notify.clear();
+    pImpl->input_notify_armed = true;
+    
+    if (options.device_cache_path) {
+        pImpl->device_cache.load(options.device_cache_path);
+    }
+    if (options.record_path) {
+        pImpl->recorder.reset(new SessionRecorder());
+        if (!pImpl->recorder->start(options.record_path)) {
+            pImpl->recorder.reset();
+            pImpl->transport.reset();
+            return false;
+        }
+    }
     if (!pImpl->discoverDevices()) {
+        pImpl->finishProbes();
+        pImpl->cleanupDevices();
+        pImpl->transport.reset();
+        pImpl->recorder.reset();
         return false;
     }
     
-    pImpl->usbThread = std::make_unique<std::thread>(&Impl::usbEventLoop, pImpl.get());
+    pImpl->saveDeviceCache();
+    pImpl->watching_arrivals = pImpl->transport->watchArrivals();
+    pImpl->device_count.store(device_count, std::memory_order_release);
+    
+    // Wait for the thread to configure itself, so getThreadReport() is accurate as soon as we return
+    std::promise<ThreadReport> started;
+    std::future<ThreadReport> report = started.get_future();
+    pImpl->usbThread = std::make_unique<std::thread>(&Impl::usbEventLoop, pImpl.get(), &started);
+    pImpl->thread_report = report.get();
     
     pImpl->initialized = true;
     return true;
@@ -353,33 +1706,235 @@ void LowLatencyDanceGameSDK::shutdown() {
     }
     
     pImpl->shutdown = true;
+    pImpl->device_count.store(0, std::memory_order_release);
     
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (pImpl->devices[i] && pImpl->devices[i]->transfer) {
-            libusb_cancel_transfer(pImpl->devices[i]->transfer);
-        }
-    }
+    // Device transfers belong to the USB thread, which may be attaching a pad; just wake it and let it cancel them
+    pImpl->transport->interruptEvents();
     
     if (pImpl->usbThread) {
         pImpl->usbThread->join();
         pImpl->usbThread.reset();
     }
     
+    pImpl->finishProbes();
     pImpl->cleanupDevices();
+    pImpl->transport.reset();
+    pImpl->recorder.reset(); // Writes out the rest of the recording
+    pImpl->saveDeviceCache();
     pImpl->initialized = false;
 }
 
+int LowLatencyDanceGameSDK::getDeviceCount() {
+    return pImpl->device_count.load(std::memory_order_acquire);
+}
+
+uint64_t LowLatencyDanceGameSDK::getMonotonicTime() {
+    return monotonicNanoseconds();
+}
+
+int LowLatencyDanceGameSDK::getInputFd() {
+    return pImpl->input_notify.fd();
+}
+
+void LowLatencyDanceGameSDK::acknowledgeInput() {
+    pImpl->input_notify.clear();
+    pImpl->input_notify_armed.exchange(true, std::memory_order_acq_rel);
+}
+
+bool LowLatencyDanceGameSDK::addGameClockSample(double game_time, uint64_t monotonic_ns) {
+    if (!pImpl->initialized) {
+        return false;
+    }
+    return pImpl->game_clock_samples.push({monotonic_ns, game_time});
+}
+
+LowLatencyDanceGameSDK::ThreadReport LowLatencyDanceGameSDK::getThreadReport() {
+    return pImpl->thread_report;
+}
+
+void LowLatencyDanceGameSDK::snapshot(Snapshot& snapshot) {
+    snapshot.device_count = pImpl->device_count.load(std::memory_order_acquire);
+    snapshot.version = pImpl->snapshots.read(snapshot.players);
+}
+
 bool LowLatencyDanceGameSDK::isPlayerConnected(Player player) {
-    int idx = static_cast<int>(player);
-    return pImpl->devices[idx] && pImpl->devices[idx]->connected;
+    DeviceState* device = pImpl->deviceFor(player);
+    return device && device->connected;
 }
 
 uint16_t LowLatencyDanceGameSDK::getPlayerButtonState(Player player) {
-    int idx = static_cast<int>(player);
-    if (!pImpl->devices[idx]) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device) {
         return 0;
     }
-    return pImpl->devices[idx]->last_button_state;
+    return device->last_button_state;
+}
+
+bool LowLatencyDanceGameSDK::getLastPress(Player player, int panel, Press& press) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || panel < 0 || panel >= PanelHistory::PANELS) {
+        return false;
+    }
+    PanelHistory::Press last;
+    if (device->presses.copy(panel, &last, 1) == 0) {
+        return false;
+    }
+    press.press_ns = last.press_ns;
+    press.release_ns = last.release_ns;
+    return true;
+}
+
+size_t LowLatencyDanceGameSDK::getPresses(Player player, int panel, uint64_t from_ns, uint64_t to_ns, Press* presses, size_t max_presses) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || !presses || panel < 0 || panel >= PanelHistory::PANELS) {
+        return 0;
+    }
+    PanelHistory::Press history[PRESS_HISTORY_LENGTH];
+    size_t count = device->presses.copy(panel, history);
+    
+    // The history comes newest first
+    size_t copied = 0;
+    for (size_t i = count; i > 0 && copied < max_presses; i--) {
+        const PanelHistory::Press& entry = history[i - 1];
+        if (entry.press_ns >= from_ns && entry.press_ns < to_ns) {
+            presses[copied].press_ns = entry.press_ns;
+            presses[copied].release_ns = entry.release_ns;
+            copied++;
+        }
+    }
+    return copied;
+}
+
+uint64_t LowLatencyDanceGameSDK::getHoldDuration(Player player, int panel) {
+    Press press;
+    if (!getLastPress(player, panel, press) || press.release_ns != 0) {
+        return 0;
+    }
+    uint64_t now = monotonicNanoseconds();
+    return now > press.press_ns ? now - press.press_ns : 0;
+}
+
+size_t LowLatencyDanceGameSDK::drainEvents(Player player, InputEvent* events, size_t max_events) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || !events) {
+        return 0;
+    }
+    return device->events.popInto(events, max_events);
+}
+
+bool LowLatencyDanceGameSDK::submitLights(Player player, const LightsFrame& frame) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || !device->connected || !device->accepts_commands) {
+        return false;
+    }
+    
+    if (frame.command_count <= 0 || frame.command_count > LightsFrame::MAX_COMMANDS) {
+        return false;
+    }
+    size_t total_size = 0;
+    for (int i = 0; i < frame.command_count; i++) {
+        if (frame.command_size[i] == 0) {
+            return false;
+        }
+        total_size += frame.command_size[i];
+    }
+    if (total_size > LightsFrame::MAX_SIZE) {
+        return false;
+    }
+    
+    device->lights.writeBuffer() = frame;
+    device->lights.publish();
+    
+    // Only wake the USB thread if it has nothing else that would make it look at the new frame
+    if (device->output_waiting.exchange(false)) {
+        pImpl->transport->interruptEvents();
+    }
+    return true;
+}
+
+bool LowLatencyDanceGameSDK::sendCommand(Player player, const uint8_t* command, size_t length,
+                                         CommandCallback callback, void* user_data) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || !device->connected || !device->accepts_commands) {
+        return false;
+    }
+    if (!command || length == 0 || length > LightsFrame::MAX_SIZE) {
+        return false;
+    }
+    
+    QueuedCommand next;
+    next.frame.command_count = 1;
+    next.frame.command_size[0] = static_cast<uint16_t>(length);
+    memcpy(next.frame.data, command, length);
+    next.callback = callback;
+    next.user_data = user_data;
+    if (!device->commands.push(next)) {
+        return false;
+    }
+    
+    // Commands are rare, so don't bother working out whether the USB thread would have noticed by itself
+    pImpl->transport->interruptEvents();
+    return true;
+}
+
+bool LowLatencyDanceGameSDK::setRepeatingCommand(Player player, const uint8_t* command, size_t length,
+                                                 ResponseCallback callback, void* user_data) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device || length > LightsFrame::MAX_SIZE) {
+        return false;
+    }
+    
+    RepeatingCommand& next = device->repeating.writeBuffer();
+    next.frame.command_count = 0;
+    if (command && length > 0) {
+        next.frame.command_count = 1;
+        next.frame.command_size[0] = static_cast<uint16_t>(length);
+        memcpy(next.frame.data, command, length);
+    }
+    next.callback = callback;
+    next.user_data = user_data;
+    next.serial = ++device->repeating_serial;
+    device->repeating.publish();
+    
+    // The USB thread may be asleep with nothing to send, so always let it know
+    pImpl->transport->interruptEvents();
+    return true;
+}
+
+bool LowLatencyDanceGameSDK::getRepeatingResponse(Player player, CommandResponse& response) {
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device) {
+        return false;
+    }
+    
+    if (const PublishedResponse* fresh = device->responses.consume()) {
+        device->latest_response = fresh;
+    }
+    const PublishedResponse* latest = device->latest_response;
+    if (!latest || latest->serial != device->repeating_serial) {
+        return false;
+    }
+    response = latest->response;
+    return true;
+}
+
+LowLatencyDanceGameSDK::LatencyStats LowLatencyDanceGameSDK::getLatencyStats(Player player) {
+    LatencyStats result = {};
+    DeviceState* device = pImpl->deviceFor(player);
+    if (!device) {
+        return result;
+    }
+    
+    const DeviceStats& stats = device->stats;
+    result.report_interval = stats.report_interval.summarize();
+    result.completion_jitter = stats.completion_jitter.summarize();
+    result.converter_time = stats.converter_time.summarize();
+    result.callback_time = stats.callback_time.summarize();
+    result.reports = stats.reports.load(std::memory_order_relaxed);
+    result.timeouts = stats.timeouts.load(std::memory_order_relaxed);
+    result.errors = stats.errors.load(std::memory_order_relaxed);
+    result.dropped_events = stats.dropped_events.load(std::memory_order_relaxed);
+    return result;
 }
 
 bool LowLatencyDanceGameSDK::isPadCompatible(uint16_t vendor_id, uint16_t product_id) {
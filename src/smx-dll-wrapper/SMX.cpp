@@ -1,6 +1,11 @@
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <mutex>
+#include <cstdio>
 #include <cstring>
+#include <cstdint>
+#include <algorithm>
 
 #include "SMX.h"
 #include "../../include/lowlatencydancegamesdk.h"
@@ -10,6 +15,10 @@ extern "C" {
 
 using namespace std;
 
+// Options SMX_Start initializes the SDK with. Not part of the SMX API, and not exported from the library;
+// tests that build this file in set it to run the wrapper against simulated pads.
+LowLatencyDanceGameSDK::Options g_sdkOptions;
+
 // Global state
 static SMXUpdateCallback* g_UpdateCallback;
 static void* g_pUserData;
@@ -17,6 +26,16 @@ static mutex g_stateMutex;
 
 // Cached state
 static SMXInfo g_info[LowLatencyDanceGameSDK::MAX_PLAYERS];
+static SensorTestMode g_testMode[LowLatencyDanceGameSDK::MAX_PLAYERS];
+static SMXConfig g_config[LowLatencyDanceGameSDK::MAX_PLAYERS];
+static bool g_haveConfig[LowLatencyDanceGameSDK::MAX_PLAYERS];
+static bool g_configRequested[LowLatencyDanceGameSDK::MAX_PLAYERS];
+static uintptr_t g_configGeneration[LowLatencyDanceGameSDK::MAX_PLAYERS]; // Bumped whenever we change the config
+
+static bool RequestConfig(int pad, LowLatencyDanceGameSDK::CommandCallback callback);
+static void OnConfigRead(LowLatencyDanceGameSDK::Player player, bool sent,
+                         const LowLatencyDanceGameSDK::CommandResponse *response, void *user_data);
+static void ResetConfigCache();
 
 // Input callback function that bridges from LLDGSDK to SMX API
 static void OnInputReceived(LowLatencyDanceGameSDK::Player player, uint16_t button_state, void* user_data)
@@ -30,6 +49,7 @@ static void OnInputReceived(LowLatencyDanceGameSDK::Player player, uint16_t butt
     }
 }
 
+#ifdef _WIN32
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserved)
 {
     switch(ul_reason_for_call)
@@ -42,6 +62,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
     }
     return TRUE;
 }
+#endif
 
 // Public API Implementation
 SMX_API void SMX_Start(SMXUpdateCallback callback, void *pUser)
@@ -51,21 +72,20 @@ SMX_API void SMX_Start(SMXUpdateCallback callback, void *pUser)
 
     // Initialize the SDK with our input callback
     auto& sdk = LowLatencyDanceGameSDK::getInstance();
-    if (!sdk.initialize(OnInputReceived, nullptr))
+    if (!sdk.initialize(OnInputReceived, nullptr, g_sdkOptions))
         return;
     
     // Set up initial state
     {
         lock_guard<mutex> lock(g_stateMutex);
-        memset(g_info, 0, sizeof(g_info));
-        
         for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
         {
+            g_info[pad] = SMXInfo();
             LowLatencyDanceGameSDK::Player player = static_cast<LowLatencyDanceGameSDK::Player>(pad);
             if (sdk.isPlayerConnected(player))
             {
                 g_info[pad].m_bConnected = true;
-                sprintf_s(g_info[pad].m_Serial, sizeof(g_info[pad].m_Serial), "LLDGSDK-P%d", pad + 1);
+                snprintf(g_info[pad].m_Serial, sizeof(g_info[pad].m_Serial), "LLDGSDK-P%d", pad + 1);
                 g_info[pad].m_iFirmwareVersion = 0x0500; // Fake version 5.0
             }
             else
@@ -73,6 +93,14 @@ SMX_API void SMX_Start(SMXUpdateCallback callback, void *pUser)
                 g_info[pad].m_bConnected = false;
             }
         }
+
+        // Fetch the configs now, so SMX_GetConfig usually has one by the time it's first called
+        ResetConfigCache();
+        for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
+        {
+            if (g_info[pad].m_bConnected)
+                RequestConfig(pad, OnConfigRead);
+        }
     }
 
     // Initial callback for all connected pads
@@ -95,6 +123,13 @@ SMX_API void SMX_Stop()
     auto& sdk = LowLatencyDanceGameSDK::getInstance();
     sdk.shutdown();
     
+    {
+        lock_guard<mutex> lock(g_stateMutex);
+        for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
+            g_testMode[pad] = SensorTestMode_Off;
+        ResetConfigCache();
+    }
+    
     g_UpdateCallback = nullptr;
     g_pUserData = nullptr;
 }
@@ -111,7 +146,7 @@ SMX_API void SMX_GetInfo(int pad, SMXInfo *info)
 
     if (pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
     {
-        memset(info, 0, sizeof(SMXInfo));
+        *info = SMXInfo();
         return;
     }
 
@@ -136,64 +171,329 @@ SMX_API uint16_t SMX_GetInputState(int pad)
     return sdk.getPlayerButtonState(player) & DancePadAdapterInputSMXDLLMask; // mask to expected bits for SMX.dll integrations
 }
 
-// Light functions - all no-ops
+// Lights are sent as up to three commands per pad, each ending in a newline:
+//
+// '2': lights 0-7 (the top two rows of the 4x4 grid) of each panel
+// '3': lights 8-15 (the bottom two rows) of each panel
+// '4': lights 16-24 (the inner 3x3 grid) of each panel, only when 25-light data was given
+static const int k_panelCount = 9;
+static const int k_lightsPerPanel4x4 = 16;
+static const int k_lightsPerPanel25 = 25;
+
+static void AppendLightsCommand(LowLatencyDanceGameSDK::LightsFrame &frame, char command,
+                                const char *padData, int lightsPerPanel, int firstLight, int lightCount)
+{
+    size_t start = 0;
+    for (int i = 0; i < frame.command_count; i++)
+        start += frame.command_size[i];
+
+    uint8_t *out = &frame.data[start];
+    size_t size = 0;
+    out[size++] = command;
+    for (int panel = 0; panel < k_panelCount; panel++)
+    {
+        const char *panelData = padData + (panel * lightsPerPanel + firstLight) * 3;
+        memcpy(&out[size], panelData, lightCount * 3);
+        size += lightCount * 3;
+    }
+    out[size++] = '\n';
+
+    frame.command_size[frame.command_count++] = static_cast<uint16_t>(size);
+}
+
 SMX_API void SMX_SetLights(const char lightData[864])
 {
-    // No-op
+    SMX_SetLights2(lightData, 864);
 }
 
 SMX_API void SMX_SetLights2(const char *lightData, int lightDataSize)
 {
-    // No-op
+    int lightsPerPanel;
+    if (lightDataSize == LowLatencyDanceGameSDK::MAX_PLAYERS * k_panelCount * k_lightsPerPanel25 * 3)
+        lightsPerPanel = k_lightsPerPanel25;
+    else if (lightDataSize == LowLatencyDanceGameSDK::MAX_PLAYERS * k_panelCount * k_lightsPerPanel4x4 * 3)
+        lightsPerPanel = k_lightsPerPanel4x4;
+    else
+        return;
+
+    // Frames are handed off to the SDK's USB thread, which only sends the newest one, so this never blocks
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    LowLatencyDanceGameSDK::LightsFrame frame;
+    for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
+    {
+        const char *padData = lightData + pad * k_panelCount * lightsPerPanel * 3;
+
+        frame.command_count = 0;
+        AppendLightsCommand(frame, '2', padData, lightsPerPanel, 0, 8);
+        AppendLightsCommand(frame, '3', padData, lightsPerPanel, 8, 8);
+        if (lightsPerPanel == k_lightsPerPanel25)
+            AppendLightsCommand(frame, '4', padData, lightsPerPanel, 16, 9);
+
+        sdk.submitLights(static_cast<LowLatencyDanceGameSDK::Player>(pad), frame);
+    }
 }
 
 SMX_API void SMX_ReenableAutoLights()
 {
-    // No-op
+    // Sent in place of a lights frame, so it also discards any lights that haven't gone out yet
+    static const char command[] = "S 1\n";
+
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    LowLatencyDanceGameSDK::LightsFrame frame;
+    frame.command_count = 1;
+    frame.command_size[0] = sizeof(command) - 1;
+    memcpy(frame.data, command, sizeof(command) - 1);
+
+    for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
+        sdk.submitLights(static_cast<LowLatencyDanceGameSDK::Player>(pad), frame);
+}
+
+// Config commands, as of firmware version 5: "G" reads the config back as "G", its size and the SMXConfig
+// bytes, and "W", the size and the bytes writes it. The SDK queues them and sends them from its USB thread
+// between lights frames, so nothing here waits on the pad. The config is cached from the first read on.
+static void ResetConfigCache()
+{
+    for (int pad = 0; pad < LowLatencyDanceGameSDK::MAX_PLAYERS; pad++)
+    {
+        g_haveConfig[pad] = false;
+        g_configRequested[pad] = false;
+        g_configGeneration[pad]++;
+    }
+}
+
+// Called with g_stateMutex held. Returns false if the read couldn't be queued.
+static bool RequestConfig(int pad, LowLatencyDanceGameSDK::CommandCallback callback)
+{
+    static const uint8_t command[] = { 'G' };
+
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    LowLatencyDanceGameSDK::Player player = static_cast<LowLatencyDanceGameSDK::Player>(pad);
+    void *generation = reinterpret_cast<void *>(g_configGeneration[pad]);
+    if (!sdk.sendCommand(player, command, sizeof(command), callback, generation))
+        return false;
+    g_configRequested[pad] = true;
+    return true;
+}
+
+// Runs on the SDK's USB thread. Returns true if the cache was updated.
+static bool StoreConfig(int pad, const LowLatencyDanceGameSDK::CommandResponse *response, void *user_data)
+{
+    lock_guard<mutex> lock(g_stateMutex);
+    g_configRequested[pad] = false;
+
+    // A read that was already queued when the config was changed would put the old one back
+    if (reinterpret_cast<uintptr_t>(user_data) != g_configGeneration[pad])
+        return false;
+    if (!response || response->size < 2 || response->data[0] != 'G')
+        return false;
+
+    // Anything the firmware didn't send keeps its default
+    size_t size = min<size_t>(response->data[1], response->size - 2);
+    SMXConfig config;
+    memcpy(&config, &response->data[2], min(size, sizeof(SMXConfig)));
+    g_config[pad] = config;
+    g_haveConfig[pad] = true;
+    return true;
+}
+
+static void OnConfigRead(LowLatencyDanceGameSDK::Player player, bool sent,
+                         const LowLatencyDanceGameSDK::CommandResponse *response, void *user_data)
+{
+    int pad = static_cast<int>(player);
+    if (StoreConfig(pad, response, user_data) && g_UpdateCallback)
+        g_UpdateCallback(pad, SMXUpdateCallback_Updated, g_pUserData);
+}
+
+static void OnFactoryResetConfigRead(LowLatencyDanceGameSDK::Player player, bool sent,
+                                     const LowLatencyDanceGameSDK::CommandResponse *response, void *user_data)
+{
+    // The reset has been sent either way; if the read failed, SMX_GetConfig starts another one
+    int pad = static_cast<int>(player);
+    StoreConfig(pad, response, user_data);
+    if (g_UpdateCallback)
+        g_UpdateCallback(pad, SMXUpdateCallback_FactoryResetCommandComplete, g_pUserData);
 }
 
-// Config functions - minimal implementation
 SMX_API bool SMX_GetConfig(int pad, SMXConfig *config)
 {
     if (!config || pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
         return false;
 
-    // Return default config
-    memset(config, 0, sizeof(SMXConfig));
-    config->masterVersion = 0x05;
-    config->configVersion = 0x05;
-    
-    return g_info[pad].m_bConnected;
+    lock_guard<mutex> lock(g_stateMutex);
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    if (!sdk.isPlayerConnected(static_cast<LowLatencyDanceGameSDK::Player>(pad)))
+    {
+        g_haveConfig[pad] = false;
+        return false;
+    }
+
+    // Nothing cached yet (or the pad was replugged): start a read, and report it through the update callback
+    if (!g_haveConfig[pad])
+    {
+        if (!g_configRequested[pad])
+            RequestConfig(pad, OnConfigRead);
+        return false;
+    }
+
+    *config = g_config[pad];
+    return true;
 }
 
 SMX_API void SMX_SetConfig(int pad, const SMXConfig *config)
 {
-    // No-op
+    if (!config || pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
+        return;
+
+    lock_guard<mutex> lock(g_stateMutex);
+    uint8_t command[2 + sizeof(SMXConfig)];
+    command[0] = 'W';
+    command[1] = sizeof(SMXConfig);
+    memcpy(&command[2], config, sizeof(SMXConfig));
+
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    LowLatencyDanceGameSDK::Player player = static_cast<LowLatencyDanceGameSDK::Player>(pad);
+    if (!sdk.sendCommand(player, command, sizeof(command)))
+        return;
+
+    // Only cache the config once the write is queued. Read it back, so the cache ends up holding whatever
+    // the firmware actually kept.
+    g_config[pad] = *config;
+    g_haveConfig[pad] = true;
+    g_configGeneration[pad]++;
+    RequestConfig(pad, OnConfigRead);
 }
 
 SMX_API void SMX_FactoryReset(int pad)
 {
-    // No-op
+    if (pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
+        return;
+
+    static const uint8_t command[] = { 'f', '\n' };
+
+    {
+        lock_guard<mutex> lock(g_stateMutex);
+        auto& sdk = LowLatencyDanceGameSDK::getInstance();
+        if (!sdk.sendCommand(static_cast<LowLatencyDanceGameSDK::Player>(pad), command, sizeof(command)))
+            return;
+
+        // The cached config is stale now. FactoryResetCommandComplete is sent once the reset config has
+        // been read back.
+        g_haveConfig[pad] = false;
+        g_configGeneration[pad]++;
+        if (RequestConfig(pad, OnFactoryResetConfigRead))
+            return;
+    }
+
+    // The read couldn't be queued, so nothing else will report that the reset finished. SMX_GetConfig
+    // reads the config again when it's next asked for it.
+    if (g_UpdateCallback)
+        g_UpdateCallback(pad, SMXUpdateCallback_FactoryResetCommandComplete, g_pUserData);
 }
 
 SMX_API void SMX_ForceRecalibration(int pad)
 {
-    // No-op
+    if (pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
+        return;
+
+    static const uint8_t command[] = { 'C', '\n' };
+
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    sdk.sendCommand(static_cast<LowLatencyDanceGameSDK::Player>(pad), command, sizeof(command));
+}
+
+// Sensor test mode. The request is "y" followed by the mode, and the SDK resends it as soon as the pad
+// answers, so readings stream at whatever rate the stage can produce them without touching the input path.
+static void OnTestDataReceived(LowLatencyDanceGameSDK::Player player, void* user_data)
+{
+    if (g_UpdateCallback)
+        g_UpdateCallback(static_cast<int>(player), SMXUpdateCallback_Updated, g_pUserData);
 }
 
-// Test mode functions - no-ops
 SMX_API void SMX_SetTestMode(int pad, SensorTestMode mode)
 {
-    // No-op
+    if (pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
+        return;
+
+    lock_guard<mutex> lock(g_stateMutex);
+    g_testMode[pad] = mode;
+
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    LowLatencyDanceGameSDK::Player player = static_cast<LowLatencyDanceGameSDK::Player>(pad);
+    if (mode == SensorTestMode_Off)
+    {
+        sdk.setRepeatingCommand(player, nullptr, 0);
+        return;
+    }
+
+    const uint8_t command[] = { 'y', static_cast<uint8_t>(mode), '\n' };
+    sdk.setRepeatingCommand(player, command, sizeof(command), OnTestDataReceived, nullptr);
+}
+
+// The response is "y", the mode, and a count of 16-bit words, one per bit of a 10-byte packed record per
+// panel: a flags byte, four little-endian int16 sensor levels, then the DIP switches in the low nibble of
+// byte 9 and the bad-jumper bits in its high nibble. Bit n of each word belongs to panel n, and each
+// record's bits are sent least significant first.
+static const int k_testRecordSize = 10;
+
+static void ReadTestRecord(const uint8_t *words, int wordCount, int panel, uint8_t record[k_testRecordSize])
+{
+    for (int i = 0; i < k_testRecordSize; i++)
+    {
+        uint8_t value = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            int word = i * 8 + bit;
+            if (word >= wordCount)
+                break;
+            uint16_t bits = words[word * 2] | (words[word * 2 + 1] << 8);
+            if (bits & (1 << panel))
+                value |= 1 << bit;
+        }
+        record[i] = value;
+    }
 }
 
 SMX_API bool SMX_GetTestData(int pad, SMXSensorTestModeData *data)
 {
-    if (!data || pad != 0)
+    if (!data || pad < 0 || pad >= LowLatencyDanceGameSDK::MAX_PLAYERS)
+        return false;
+
+    lock_guard<mutex> lock(g_stateMutex);
+    if (g_testMode[pad] == SensorTestMode_Off)
+        return false;
+
+    // Kept off the stack; it's a whole response buffer
+    static LowLatencyDanceGameSDK::CommandResponse response;
+    auto& sdk = LowLatencyDanceGameSDK::getInstance();
+    if (!sdk.getRepeatingResponse(static_cast<LowLatencyDanceGameSDK::Player>(pad), response))
+        return false;
+
+    if (response.size < 3 || response.data[0] != 'y' || response.data[1] != g_testMode[pad])
+        return false;
+    int wordCount = response.data[2];
+    if (response.size < 3 + static_cast<size_t>(wordCount) * 2)
         return false;
 
     memset(data, 0, sizeof(SMXSensorTestModeData));
-    return false;
+    for (int panel = 0; panel < k_panelCount; panel++)
+    {
+        uint8_t record[k_testRecordSize];
+        ReadTestRecord(&response.data[3], wordCount, panel, record);
+
+        // Every record starts with the bits 0, 1, 0; anything else means the panel didn't answer
+        if ((record[0] & 0x07) != 0x02)
+            continue;
+
+        data->bHaveDataFromPanel[panel] = true;
+        for (int sensor = 0; sensor < 4; sensor++)
+        {
+            data->bBadSensorInput[panel][sensor] = (record[0] >> (3 + sensor)) & 1;
+            data->sensorLevel[panel][sensor] = static_cast<int16_t>(record[1 + sensor * 2] | (record[2 + sensor * 2] << 8));
+            data->iBadJumper[panel][sensor] = (record[9] >> (4 + sensor)) & 1;
+        }
+        data->iDIPSwitchPerPanel[panel] = record[9] & 0x0F;
+    }
+    return true;
 }
 
 SMX_API void SMX_SetPanelTestMode(PanelTestMode mode)
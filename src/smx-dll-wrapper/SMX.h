@@ -4,17 +4,25 @@
 #include <stdint.h>
 #include <stddef.h> // for offsetof
 
+#if defined(_WIN32)
 #ifdef SMX_EXPORTS
 #define SMX_API extern "C" __declspec(dllexport)
 #else
 #define SMX_API extern "C" __declspec(dllimport)
 #endif
+#elif defined(SMX_EXPORTS)
+#define SMX_API extern "C" __attribute__((visibility("default")))
+#else
+#define SMX_API extern "C"
+#endif
 
+// The enums are declared ahead of the functions that use them, which standard C++ only allows with a
+// fixed underlying type. int is what MSVC gives them anyway, so the ABI is the same as SMX.dll's.
 struct SMXInfo;
 struct SMXConfig;
-enum SensorTestMode;
-enum PanelTestMode;
-enum SMXUpdateCallbackReason;
+enum SensorTestMode : int;
+enum PanelTestMode : int;
+enum SMXUpdateCallbackReason : int;
 struct SMXSensorTestModeData;
 
 // All functions are nonblocking.  Getters will return the most recent state.  Setters will
@@ -141,7 +149,7 @@ struct SMXInfo
     uint16_t m_iFirmwareVersion;
 };
 
-enum SMXUpdateCallbackReason {
+enum SMXUpdateCallbackReason : int {
     // This is called when a generic state change happens: connection or disconnection, inputs changed,
     // test data updated, etc.  It doesn't specify what's changed.  We simply check the whole state.
     SMXUpdateCallback_Updated,
@@ -278,7 +286,7 @@ static_assert(offsetof(SMXConfig, padding) == 201, "Incorrect padding alignment"
 static_assert(sizeof(SMXConfig) == 250, "Expected 250 bytes");
 
 // The values (except for Off) correspond with the protocol and must not be changed.
-enum SensorTestMode {
+enum SensorTestMode : int {
     SensorTestMode_Off = 0,
     // Return the raw, uncalibrated value of each sensor.
     SensorTestMode_UncalibratedValues = '0',
@@ -311,7 +319,7 @@ struct SMXSensorTestModeData
 
 // The values also correspond with the protocol and must not be changed.
 // These are panel-side diagnostics modes.
-enum PanelTestMode {
+enum PanelTestMode : int {
     PanelTestMode_Off = '0',
     PanelTestMode_PressureTest = '1',
 };
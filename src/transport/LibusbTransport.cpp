@@ -0,0 +1,333 @@
+#include "LibusbTransport.h"
+#include "SysfsReportDescriptor.h"
+
+extern "C" {
+    #include "../adapters/AdapterBase.h"
+}
+
+struct LibusbConnection : PadConnection {
+    libusb_device_handle* handle = nullptr;
+    bool detached_kernel_driver = false; // Hand the interface back to the OS on close
+};
+
+struct LibusbPadTransfer : PadTransfer {
+    libusb_transfer* transfer = nullptr;
+};
+
+LibusbTransport::~LibusbTransport() {
+    stop();
+}
+
+bool LibusbTransport::start() {
+    if (ctx_ == nullptr) {
+        if (libusb_init(&ctx_) < 0) {
+            ctx_ = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void LibusbTransport::stop() {
+    if (hotplug_registered_) {
+        libusb_hotplug_deregister_callback(ctx_, hotplug_handle_);
+        hotplug_registered_ = false;
+    }
+    if (ctx_) {
+        libusb_exit(ctx_);
+        ctx_ = nullptr;
+    }
+}
+
+// Picks the interface a device is opened on: its first HID interface that isn't a boot keyboard or mouse,
+// or failing that its first HID interface of any kind. Returns whether it found one of the first sort.
+static bool findHIDCandidate(libusb_device* device, uint8_t* hid_interface) {
+    struct libusb_config_descriptor *config;
+    if (libusb_get_active_config_descriptor(device, &config) < 0) {
+        return false;
+    }
+    bool found_any = false;
+    bool found_candidate = false;
+    for (int i = 0; i < config->bNumInterfaces && !found_candidate; i++) {
+        const struct libusb_interface_descriptor *intf = &config->interface[i].altsetting[0];
+        if (intf->bInterfaceClass != 3) {
+            continue;
+        }
+        if (intf->bInterfaceProtocol == 0) {
+            *hid_interface = intf->bInterfaceNumber;
+            found_candidate = true;
+        } else if (!found_any) {
+            *hid_interface = intf->bInterfaceNumber;
+        }
+        found_any = true;
+    }
+    libusb_free_config_descriptor(config);
+    return found_candidate;
+}
+
+bool LibusbTransport::listDevices(std::vector<PadDeviceInfo>& devices) {
+    libusb_device **device_list;
+    ssize_t device_count = libusb_get_device_list(ctx_, &device_list);
+    
+    if (device_count < 0) {
+        return false;
+    }
+    
+    for (ssize_t i = 0; i < device_count; i++) {
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(device_list[i], &desc) < 0) {
+            continue;
+        }
+        
+        PadDeviceInfo info;
+        info.vendor_id = desc.idVendor;
+        info.product_id = desc.idProduct;
+        info.bus_number = libusb_get_bus_number(device_list[i]);
+        info.device_address = libusb_get_device_address(device_list[i]);
+        int port_path_length = libusb_get_port_numbers(device_list[i], info.port_path, sizeof(info.port_path));
+        info.port_path_length = port_path_length > 0 ? port_path_length : 0;
+        
+        info.hid_candidate = findHIDCandidate(device_list[i], &info.hid_interface);
+        info.native = libusb_ref_device(device_list[i]);
+        devices.push_back(info);
+    }
+    
+    libusb_free_device_list(device_list, 1);
+    return true;
+}
+
+void LibusbTransport::releaseDevices(std::vector<PadDeviceInfo>& devices) {
+    for (PadDeviceInfo& info : devices) {
+        libusb_unref_device(static_cast<libusb_device*>(info.native));
+    }
+    devices.clear();
+}
+
+// Finds HID interface `interface_number` in the active configuration and its interrupt endpoints
+static bool findHIDInterface(libusb_device_handle* handle, uint8_t interface_number, PadConnection* layout) {
+    struct libusb_config_descriptor *config;
+    if (libusb_get_active_config_descriptor(libusb_get_device(handle), &config) < 0) {
+        return false;
+    }
+    
+    int hid_interface_index = -1;
+    for (int i = 0; i < config->bNumInterfaces; i++) {
+        const struct libusb_interface_descriptor *intf = &config->interface[i].altsetting[0];
+        if (intf->bInterfaceClass == 3 && intf->bInterfaceNumber == interface_number) {
+            layout->hid_interface = intf->bInterfaceNumber;
+            hid_interface_index = i;
+            break;
+        }
+    }
+    
+    if (hid_interface_index == -1) {
+        libusb_free_config_descriptor(config);
+        return false;
+    }
+    
+    for (int i = 0; i < config->interface[hid_interface_index].altsetting[0].bNumEndpoints; i++) {
+        const struct libusb_endpoint_descriptor *ep = &config->interface[hid_interface_index].altsetting[0].endpoint[i];
+        
+        bool is_interrupt = (ep->bmAttributes & 0x03) == 0x03;
+        bool is_input = (ep->bEndpointAddress & 0x80) != 0;
+        bool is_output = (ep->bEndpointAddress & 0x80) == 0;
+        
+        if (is_interrupt && is_input && layout->interrupt_in_endpoint == 0) {
+            layout->interrupt_in_endpoint = ep->bEndpointAddress;
+            layout->in_packet_size = ep->wMaxPacketSize & 0x7FF; // Bits 11-12 are the high-bandwidth multiplier
+        }
+        if (is_interrupt && is_output && layout->interrupt_out_endpoint == 0) {
+            layout->interrupt_out_endpoint = ep->bEndpointAddress;
+            layout->out_packet_size = ep->wMaxPacketSize & 0x7FF;
+        }
+    }
+    
+    libusb_free_config_descriptor(config);
+    return layout->interrupt_in_endpoint != 0;
+}
+
+PadConnection* LibusbTransport::open(const PadDeviceInfo& device, const PadConnection* known) {
+    libusb_device_handle *handle;
+    if (libusb_open(static_cast<libusb_device*>(device.native), &handle) < 0) {
+        return nullptr;
+    }
+    
+    PadConnection layout;
+    if (known) {
+        layout = *known;
+    } else if (!findHIDInterface(handle, device.hid_interface, &layout)) {
+        libusb_close(handle);
+        return nullptr;
+    }
+    int hid_interface = layout.hid_interface;
+    
+    bool detached_kernel_driver = false;
+    if (libusb_kernel_driver_active(handle, hid_interface) == 1) {
+        if (libusb_detach_kernel_driver(handle, hid_interface) != 0) {
+            libusb_close(handle);
+            return nullptr;
+        }
+        detached_kernel_driver = true;
+    }
+    
+    if (libusb_claim_interface(handle, hid_interface) < 0) {
+        if (detached_kernel_driver) {
+            libusb_attach_kernel_driver(handle, hid_interface);
+        }
+        libusb_close(handle);
+        return nullptr;
+    }
+    
+    LibusbConnection* connection = new LibusbConnection();
+    static_cast<PadConnection&>(*connection) = layout;
+    connection->handle = handle;
+    connection->detached_kernel_driver = detached_kernel_driver;
+    return connection;
+}
+
+void LibusbTransport::close(PadConnection* connection) {
+    LibusbConnection* libusb_connection = static_cast<LibusbConnection*>(connection);
+    libusb_release_interface(libusb_connection->handle, libusb_connection->hid_interface);
+    if (libusb_connection->detached_kernel_driver) {
+        libusb_attach_kernel_driver(libusb_connection->handle, libusb_connection->hid_interface);
+    }
+    libusb_close(libusb_connection->handle);
+    delete libusb_connection;
+}
+
+int LibusbTransport::interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                                       int* transferred, unsigned int timeout_ms) {
+    return libusb_interrupt_transfer(static_cast<LibusbConnection*>(connection)->handle, endpoint,
+                                     data, length, transferred, timeout_ms);
+}
+
+int LibusbTransport::getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) {
+    LibusbConnection* libusb_connection = static_cast<LibusbConnection*>(connection);
+    return libusb_control_transfer(
+        libusb_connection->handle,
+        LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_STANDARD | LIBUSB_RECIPIENT_INTERFACE,
+        LIBUSB_REQUEST_GET_DESCRIPTOR,
+        LIBUSB_DT_REPORT << 8,
+        libusb_connection->hid_interface,
+        buffer,
+        static_cast<uint16_t>(length),
+        1000
+    );
+}
+
+int LibusbTransport::readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) {
+#ifdef __linux__
+    return readSysfsReportDescriptor(device, buffer, length);
+#else
+    return LIBUSB_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+PadTransfer* LibusbTransport::allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                                            unsigned int timeout_ms, PadTransferCallback callback, void* user_data) {
+    libusb_transfer* transfer = libusb_alloc_transfer(0);
+    if (!transfer) {
+        return nullptr;
+    }
+    
+    LibusbPadTransfer* pad_transfer = new LibusbPadTransfer();
+    pad_transfer->endpoint = endpoint;
+    pad_transfer->buffer = buffer;
+    pad_transfer->length = length;
+    pad_transfer->callback = callback;
+    pad_transfer->user_data = user_data;
+    pad_transfer->transfer = transfer;
+    
+    libusb_fill_interrupt_transfer(
+        transfer,
+        static_cast<LibusbConnection*>(connection)->handle,
+        endpoint,
+        buffer,
+        length,
+        transferCallback,
+        pad_transfer,
+        timeout_ms
+    );
+    return pad_transfer;
+}
+
+void LibusbTransport::freeTransfer(PadTransfer* transfer) {
+    LibusbPadTransfer* pad_transfer = static_cast<LibusbPadTransfer*>(transfer);
+    libusb_free_transfer(pad_transfer->transfer);
+    delete pad_transfer;
+}
+
+bool LibusbTransport::submitTransfer(PadTransfer* transfer) {
+    return libusb_submit_transfer(static_cast<LibusbPadTransfer*>(transfer)->transfer) == 0;
+}
+
+void LibusbTransport::cancelTransfer(PadTransfer* transfer) {
+    libusb_cancel_transfer(static_cast<LibusbPadTransfer*>(transfer)->transfer);
+}
+
+void LIBUSB_CALL LibusbTransport::transferCallback(libusb_transfer* transfer) {
+    LibusbPadTransfer* pad_transfer = static_cast<LibusbPadTransfer*>(transfer->user_data);
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED: pad_transfer->status = PadTransferStatus::Completed; break;
+        case LIBUSB_TRANSFER_TIMED_OUT: pad_transfer->status = PadTransferStatus::TimedOut; break;
+        case LIBUSB_TRANSFER_CANCELLED: pad_transfer->status = PadTransferStatus::Cancelled; break;
+        case LIBUSB_TRANSFER_NO_DEVICE: pad_transfer->status = PadTransferStatus::NoDevice; break;
+        default:                        pad_transfer->status = PadTransferStatus::Error; break;
+    }
+    pad_transfer->actual_length = transfer->actual_length;
+    pad_transfer->callback(pad_transfer);
+}
+
+void LibusbTransport::handleEvents(uint64_t timeout_ns) {
+    int completed = 0;
+    struct timeval timeout = {
+        static_cast<long>(timeout_ns / 1000000000),
+        static_cast<long>((timeout_ns % 1000000000) / 1000)
+    };
+    libusb_handle_events_timeout_completed(ctx_, &timeout, &completed);
+}
+
+void LibusbTransport::interruptEvents() {
+    libusb_interrupt_event_handler(ctx_);
+}
+
+int LIBUSB_CALL LibusbTransport::hotplugCallback(libusb_context* ctx, libusb_device* device, libusb_hotplug_event event, void* user_data) {
+    // Opening or probing isn't allowed inside a hotplug callback, so just flag it for the event loop. A
+    // device with no adapter may still be a generic HID pad, so those are flagged too; the scan decides.
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(device, &desc) != 0) {
+        return 0;
+    }
+    uint8_t hid_interface;
+    if (dance_pad_is_pid_vid_valid_pad(desc.idVendor, desc.idProduct) || findHIDCandidate(device, &hid_interface)) {
+        static_cast<LibusbTransport*>(user_data)->arrived_ = true;
+    }
+    return 0;
+}
+
+bool LibusbTransport::watchArrivals() {
+    if (hotplug_registered_) {
+        return true;
+    }
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        return false;
+    }
+    hotplug_registered_ = libusb_hotplug_register_callback(
+        ctx_,
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED,
+        LIBUSB_HOTPLUG_NO_FLAGS,
+        LIBUSB_HOTPLUG_MATCH_ANY,
+        LIBUSB_HOTPLUG_MATCH_ANY,
+        LIBUSB_HOTPLUG_MATCH_ANY,
+        hotplugCallback,
+        this,
+        &hotplug_handle_
+    ) == LIBUSB_SUCCESS;
+    return hotplug_registered_;
+}
+
+bool LibusbTransport::takeArrivals() {
+    bool arrived = arrived_;
+    arrived_ = false;
+    return arrived;
+}
@@ -0,0 +1,48 @@
+#ifndef LLDGSDK_LIBUSBTRANSPORT_H
+#define LLDGSDK_LIBUSBTRANSPORT_H
+
+#include "PadTransport.h"
+
+#include <libusb.h>
+
+class LibusbTransport : public PadTransport {
+public:
+    ~LibusbTransport() override;
+
+    bool start() override;
+    void stop() override;
+
+    bool listDevices(std::vector<PadDeviceInfo>& devices) override;
+    void releaseDevices(std::vector<PadDeviceInfo>& devices) override;
+
+    PadConnection* open(const PadDeviceInfo& device, const PadConnection* known) override;
+    void close(PadConnection* connection) override;
+
+    int interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                          int* transferred, unsigned int timeout_ms) override;
+    int getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) override;
+    int readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) override;
+
+    PadTransfer* allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                               unsigned int timeout_ms, PadTransferCallback callback, void* user_data) override;
+    void freeTransfer(PadTransfer* transfer) override;
+    bool submitTransfer(PadTransfer* transfer) override;
+    void cancelTransfer(PadTransfer* transfer) override;
+
+    void handleEvents(uint64_t timeout_ns) override;
+    void interruptEvents() override;
+
+    bool watchArrivals() override;
+    bool takeArrivals() override;
+
+private:
+    static void LIBUSB_CALL transferCallback(libusb_transfer* transfer);
+    static int LIBUSB_CALL hotplugCallback(libusb_context* ctx, libusb_device* device, libusb_hotplug_event event, void* user_data);
+
+    libusb_context* ctx_ = nullptr;
+    bool hotplug_registered_ = false;
+    libusb_hotplug_callback_handle hotplug_handle_;
+    bool arrived_ = false; // Set from hotplugCallback, which libusb runs on the event thread
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef LLDGSDK_PADTRANSPORT_H
+#define LLDGSDK_PADTRANSPORT_H
+
+#include <cstdint>
+#include <vector>
+
+enum class PadTransferStatus {
+    Completed,
+    TimedOut,
+    Cancelled,
+    NoDevice,
+    Error,
+};
+
+struct PadTransfer;
+using PadTransferCallback = void(*)(PadTransfer* transfer);
+
+// An asynchronous interrupt transfer. Backends allocate these (usually as part of a larger struct) and
+// fill in `status` and `actual_length` before calling `callback` on the event thread.
+struct PadTransfer {
+    uint8_t endpoint = 0;
+    uint8_t* buffer = nullptr;
+    int length = 0;
+    int actual_length = 0;
+    PadTransferStatus status = PadTransferStatus::Completed;
+    PadTransferCallback callback = nullptr;
+    void* user_data = nullptr;
+};
+
+// A USB device as seen during enumeration
+struct PadDeviceInfo {
+    uint16_t vendor_id = 0;
+    uint16_t product_id = 0;
+    uint8_t bus_number = 0;
+    uint8_t device_address = 0;
+    uint8_t port_path[8] = {0};
+    int port_path_length = 0;
+    bool hid_candidate = false; // Has a HID interface that isn't a boot keyboard or mouse
+    uint8_t hid_interface = 0;  // The interface open() claims: that one if so, otherwise the first HID interface
+    void* native = nullptr; // The backend's own reference, dropped by releaseDevices()
+};
+
+// An opened pad with its HID interface claimed
+struct PadConnection {
+    uint8_t hid_interface = 0;
+    uint8_t interrupt_in_endpoint = 0;
+    uint8_t interrupt_out_endpoint = 0;
+    int in_packet_size = 0;
+    int out_packet_size = 0;
+};
+
+// Everything the SDK needs from the USB stack. The SDK core only talks to pads through this, so the same
+// input path runs on libusb or on a simulated stand-in.
+class PadTransport {
+public:
+    virtual ~PadTransport() {}
+
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+    // Every device listed must be handed back through releaseDevices()
+    virtual bool listDevices(std::vector<PadDeviceInfo>& devices) = 0;
+    virtual void releaseDevices(std::vector<PadDeviceInfo>& devices) = 0;
+
+    // Opens `device` and claims its HID interface, `device.hid_interface`. Returns nullptr if that isn't possible.
+    //
+    // `known`, if not null, is the interface and endpoints the device had the last time it was opened on the
+    // same port. The backend claims that interface and takes those endpoints as they are rather than reading
+    // the configuration descriptor, and fails if the interface can't be claimed.
+    //
+    // The SDK probes new pads on threads of their own, so open(), interruptTransfer(), getReportDescriptor()
+    // and close() must work from any thread, alongside the event thread and probes of other devices, for
+    // as long as the connection has no async transfers.
+    virtual PadConnection* open(const PadDeviceInfo& device, const PadConnection* known) = 0;
+    virtual void close(PadConnection* connection) = 0;
+
+    // Blocking transfer used while probing a pad. Returns 0 or a negative error, like libusb_interrupt_transfer.
+    virtual int interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                                  int* transferred, unsigned int timeout_ms) = 0;
+
+    // Reads the HID report descriptor of the claimed interface. Returns its length or a negative error.
+    virtual int getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) = 0;
+
+    // Reads the report descriptor of `device.hid_interface` without opening the device, from the copy the
+    // OS kept when its own HID driver bound the interface, so a device that turns out not to be a pad is
+    // never taken from that driver. Returns its length, or a negative error if the OS has no copy, in
+    // which case the SDK opens the device and asks it. Called from probe threads, like open().
+    virtual int readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) = 0;
+
+    // Asynchronous transfers. Submitting, cancelling and completion callbacks all happen on the event thread.
+    virtual PadTransfer* allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                                       unsigned int timeout_ms, PadTransferCallback callback, void* user_data) = 0;
+    virtual void freeTransfer(PadTransfer* transfer) = 0;
+    virtual bool submitTransfer(PadTransfer* transfer) = 0;
+    virtual void cancelTransfer(PadTransfer* transfer) = 0;
+
+    // Runs completion callbacks, waiting up to `timeout_ns` for something to complete
+    virtual void handleEvents(uint64_t timeout_ns) = 0;
+    // Wakes handleEvents() early; safe to call from any thread
+    virtual void interruptEvents() = 0;
+
+    // watchArrivals() returns false if the backend can't report new devices, in which case the SDK
+    // rescans periodically. takeArrivals() is polled on the event thread and clears the flag.
+    virtual bool watchArrivals() = 0;
+    virtual bool takeArrivals() = 0;
+};
+
+#endif
@@ -0,0 +1,644 @@
+#include "SimulatedTransport.h"
+#include "../MonotonicClock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+    #include "../adapters/SMXStage/SMXStageAdapter.h"
+    #include "../adapters/FoamPad/FoamPadAdapter.h"
+    #include "../adapters/HIDPad/HIDPadAdapter.h"
+}
+
+// Same value libusb uses, so adapters treat a silent simulated pad like a silent real one
+static const int k_error_timeout = -7;
+
+static const uint8_t k_in_endpoint = 0x81;
+static const uint8_t k_out_endpoint = 0x02;
+static const int k_smx_packet_size = 64;
+static const int k_foam_report_size = 8;
+
+// The HID kind is an unregistered gamepad with 16 buttons in a two-byte report
+static const uint16_t k_hid_vendor_id = 0x1209;
+static const uint16_t k_hid_product_id = 0x0001;
+static const int k_hid_report_size = 2;
+static const uint8_t k_hid_report_descriptor[] = {
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x05, // Usage (Game Pad)
+    0xA1, 0x01, // Collection (Application)
+    0x05, 0x09, //   Usage Page (Button)
+    0x19, 0x01, //   Usage Minimum (1)
+    0x29, 0x10, //   Usage Maximum (16)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x01, //   Logical Maximum (1)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x10, //   Report Count (16)
+    0x81, 0x02, //   Input (Data, Variable, Absolute)
+    0xC0,       // End Collection
+};
+
+// SMX report IDs and packet flags, as in SMXStageAdapter.c
+static const uint8_t k_smx_report_input = 3;
+static const uint8_t k_smx_report_command = 5;
+static const uint8_t k_smx_report_response = 6;
+static const uint8_t k_smx_end_of_command = 0x01;
+static const uint8_t k_smx_host_cmd_done = 0x02;
+static const uint8_t k_smx_start_of_command = 0x04;
+static const uint8_t k_smx_device_info = 0x80;
+
+static const int k_smx_panel_count = 9;
+static const int k_smx_config_size = 250; // sizeof(SMXConfig)
+
+static const int k_max_responses = 8;
+static const int k_max_command_size = 1024;
+
+struct SimulatedTransport::Transfer : PadTransfer {
+    Pad* pad = nullptr;
+    unsigned int timeout_ms = 0;
+    bool submitted = false;
+    bool cancelled = false;
+    uint64_t deadline_ns = 0;
+    uint64_t submit_order = 0;
+};
+
+struct SimulatedTransport::Pad : PadConnection {
+    LowLatencyDanceGameSDK::SimulatedPad config;
+    PadDeviceInfo info;
+    std::atomic<bool> opened{false};
+
+    uint64_t report_interval_ns = 0;
+    uint64_t next_report_ns = 0;
+    uint16_t state = 0;
+    size_t script_position = 0;
+    uint32_t random_state = 1;
+
+    // Packets the pad has queued for the host, sent ahead of input reports
+    struct Response {
+        uint8_t data[k_smx_packet_size];
+        int length;
+    };
+    Response responses[k_max_responses];
+    int response_head = 0;
+    int response_count = 0;
+
+    uint8_t command[k_max_command_size];
+    int command_length = 0;
+    bool probe_pending = false; // The next read answers a player-ID probe, after probe_delay_ms
+    int input_submits = 0;      // Input transfers submitted so far, for SimulatedPad::fail_input_submit
+
+    // Stored configuration, read with "G" and written with "W"
+    uint8_t stage_config[k_smx_config_size];
+
+    std::vector<Transfer*> transfers; // Every transfer allocated on this pad, submitted or not
+};
+
+SimulatedTransport::SimulatedTransport(const LowLatencyDanceGameSDK::SimulatedPad* pads, int pad_count) {
+    for (int i = 0; i < pad_count; i++) {
+        std::unique_ptr<Pad> pad(new Pad());
+        pad->config = pads[i];
+
+        bool smx = pads[i].kind == LowLatencyDanceGameSDK::SimulatedPad::Kind::SMX;
+        bool hid = pads[i].kind == LowLatencyDanceGameSDK::SimulatedPad::Kind::HID;
+        if (hid) {
+            pad->info.vendor_id = k_hid_vendor_id;
+            pad->info.product_id = k_hid_product_id;
+        } else {
+            DancePadAdapter adapter = smx ? default_smx_adapter() : default_foam_pad_adapter();
+            pad->info.vendor_id = adapter.vendor_id;
+            pad->info.product_id = adapter.product_id;
+        }
+        pad->info.hid_candidate = true;
+        pad->info.hid_interface = pad->hid_interface;
+        pad->info.bus_number = pads[i].bus_number;
+        pad->info.device_address = static_cast<uint8_t>(i + 2);
+        pad->info.port_path_length = pads[i].port_path_length;
+        memcpy(pad->info.port_path, pads[i].port_path, sizeof(pad->info.port_path));
+        pad->info.native = pad.get();
+
+        pad->interrupt_in_endpoint = k_in_endpoint;
+        pad->in_packet_size = smx ? k_smx_packet_size : hid ? k_hid_report_size : k_foam_report_size;
+        if (smx) {
+            pad->interrupt_out_endpoint = k_out_endpoint;
+            pad->out_packet_size = k_smx_packet_size;
+        }
+
+        if (pads[i].report_rate_hz > 0) {
+            pad->report_interval_ns = 1000000000ull / pads[i].report_rate_hz;
+        }
+        pad->random_state = pads[i].random_seed ? pads[i].random_seed : 1;
+        resetStageConfig(pad.get());
+        pads_.push_back(std::move(pad));
+    }
+}
+
+SimulatedTransport::~SimulatedTransport() {
+    stop();
+}
+
+bool SimulatedTransport::start() {
+    // Capacity for every transfer that could complete in one pass, so handleEvents() never allocates
+    ready_.reserve(64 * (pads_.size() + 1));
+    return true;
+}
+
+void SimulatedTransport::stop() {
+}
+
+bool SimulatedTransport::listDevices(std::vector<PadDeviceInfo>& devices) {
+    for (const std::unique_ptr<Pad>& pad : pads_) {
+        devices.push_back(pad->info);
+    }
+    return true;
+}
+
+void SimulatedTransport::releaseDevices(std::vector<PadDeviceInfo>& devices) {
+    devices.clear();
+}
+
+PadConnection* SimulatedTransport::open(const PadDeviceInfo& device, const PadConnection* known) {
+    Pad* pad = static_cast<Pad*>(device.native);
+    if (pad == nullptr) {
+        return nullptr;
+    }
+    // A remembered interface that isn't this pad's can't be claimed
+    if (known && known->hid_interface != pad->hid_interface) {
+        return nullptr;
+    }
+    if (pad->opened.exchange(true)) {
+        return nullptr;
+    }
+    pad->response_head = 0;
+    pad->response_count = 0;
+    pad->command_length = 0;
+    pad->probe_pending = false;
+    pad->next_report_ns = monotonicNanoseconds() + pad->report_interval_ns;
+    return pad;
+}
+
+void SimulatedTransport::close(PadConnection* connection) {
+    static_cast<Pad*>(connection)->opened = false;
+}
+
+int SimulatedTransport::interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                                          int* transferred, unsigned int timeout_ms) {
+    Pad* pad = static_cast<Pad*>(connection);
+    *transferred = 0;
+
+    if ((endpoint & 0x80) == 0) {
+        receivePacket(pad, data, length);
+        *transferred = length;
+        return 0;
+    }
+
+    if (pad->probe_pending) {
+        pad->probe_pending = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(pad->config.probe_delay_ms));
+    }
+
+    if (pad->response_count > 0) {
+        Pad::Response& response = pad->responses[pad->response_head];
+        int size = response.length < length ? response.length : length;
+        memcpy(data, response.data, size);
+        pad->response_head = (pad->response_head + 1) % k_max_responses;
+        pad->response_count--;
+        *transferred = size;
+        return 0;
+    }
+
+    if (pad->report_interval_ns == 0) {
+        return k_error_timeout;
+    }
+    advanceInput(pad);
+    *transferred = buildInputReport(pad, data, length);
+    return 0;
+}
+
+int SimulatedTransport::getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) {
+    // Only the HID kind needs a descriptor; the others are recognised by VID/PID
+    if (static_cast<Pad*>(connection)->config.kind != LowLatencyDanceGameSDK::SimulatedPad::Kind::HID) {
+        return k_error_timeout;
+    }
+    int size = static_cast<int>(sizeof(k_hid_report_descriptor));
+    if (size > length) {
+        size = length;
+    }
+    memcpy(buffer, k_hid_report_descriptor, size);
+    return size;
+}
+
+int SimulatedTransport::readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) {
+    // Stands in for the copy the OS keeps, so it's there whether or not the pad is open
+    return getReportDescriptor(static_cast<Pad*>(device.native), buffer, length);
+}
+
+PadTransfer* SimulatedTransport::allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                                               unsigned int timeout_ms, PadTransferCallback callback, void* user_data) {
+    Transfer* transfer = new Transfer();
+    transfer->endpoint = endpoint;
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->callback = callback;
+    transfer->user_data = user_data;
+    transfer->pad = static_cast<Pad*>(connection);
+    transfer->timeout_ms = timeout_ms;
+    transfer->pad->transfers.push_back(transfer);
+    return transfer;
+}
+
+void SimulatedTransport::freeTransfer(PadTransfer* transfer) {
+    Transfer* simulated = static_cast<Transfer*>(transfer);
+    std::vector<Transfer*>& transfers = simulated->pad->transfers;
+    for (size_t i = 0; i < transfers.size(); i++) {
+        if (transfers[i] == simulated) {
+            transfers.erase(transfers.begin() + i);
+            break;
+        }
+    }
+    delete simulated;
+}
+
+bool SimulatedTransport::submitTransfer(PadTransfer* transfer) {
+    Transfer* simulated = static_cast<Transfer*>(transfer);
+    if (!simulated->pad->opened || simulated->submitted) {
+        return false;
+    }
+    if ((simulated->endpoint & 0x80) && ++simulated->pad->input_submits == simulated->pad->config.fail_input_submit) {
+        return false;
+    }
+    simulated->submitted = true;
+    simulated->cancelled = false;
+    simulated->submit_order = ++submit_counter_;
+    simulated->deadline_ns = simulated->timeout_ms
+        ? monotonicNanoseconds() + simulated->timeout_ms * 1000000ull
+        : UINT64_MAX;
+    return true;
+}
+
+void SimulatedTransport::cancelTransfer(PadTransfer* transfer) {
+    Transfer* simulated = static_cast<Transfer*>(transfer);
+    if (simulated->submitted) {
+        simulated->cancelled = true;
+    }
+}
+
+void SimulatedTransport::handleEvents(uint64_t timeout_ns) {
+    uint64_t now = monotonicNanoseconds();
+    uint64_t wake_ns = now + timeout_ns;
+    uint64_t next_ns = nextEventTime(now);
+    if (next_ns < wake_ns) {
+        wake_ns = next_ns;
+    }
+
+    if (wake_ns > now) {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        std::chrono::steady_clock::time_point deadline{std::chrono::nanoseconds(wake_ns)};
+        wake_.wait_until(lock, deadline, [this] { return woken_; });
+        woken_ = false;
+    }
+
+    runDue(monotonicNanoseconds());
+}
+
+void SimulatedTransport::interruptEvents() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        woken_ = true;
+    }
+    wake_.notify_one();
+}
+
+bool SimulatedTransport::watchArrivals() {
+    // Simulated pads are all present from the start
+    return true;
+}
+
+bool SimulatedTransport::takeArrivals() {
+    return false;
+}
+
+uint64_t SimulatedTransport::nextEventTime(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    for (const std::unique_ptr<Pad>& pad : pads_) {
+        bool input_waiting = false;
+        for (Transfer* transfer : pad->transfers) {
+            if (!transfer->submitted) {
+                continue;
+            }
+            if (transfer->cancelled || (transfer->endpoint & 0x80) == 0) {
+                return now;
+            }
+            input_waiting = true;
+            if (transfer->deadline_ns < next) {
+                next = transfer->deadline_ns;
+            }
+        }
+        if (input_waiting && pad->response_count > 0) {
+            return now;
+        }
+        if (input_waiting && pad->report_interval_ns && pad->next_report_ns < next) {
+            next = pad->next_report_ns;
+        }
+    }
+    return next;
+}
+
+SimulatedTransport::Transfer* SimulatedTransport::oldestSubmitted(Pad* pad, bool input) {
+    Transfer* oldest = nullptr;
+    for (Transfer* transfer : pad->transfers) {
+        if (!transfer->submitted || transfer->cancelled || ((transfer->endpoint & 0x80) != 0) != input) {
+            continue;
+        }
+        if (oldest == nullptr || transfer->submit_order < oldest->submit_order) {
+            oldest = transfer;
+        }
+    }
+    return oldest;
+}
+
+void SimulatedTransport::finish(Transfer* transfer, PadTransferStatus status, int actual_length) {
+    transfer->submitted = false;
+    transfer->cancelled = false;
+    transfer->status = status;
+    transfer->actual_length = actual_length;
+    ready_.push_back(transfer);
+}
+
+void SimulatedTransport::runDue(uint64_t now) {
+    ready_.clear();
+
+    for (const std::unique_ptr<Pad>& owned : pads_) {
+        Pad* pad = owned.get();
+
+        // A pad with no transfers may still be answering a probe on another thread
+        if (pad->transfers.empty()) {
+            continue;
+        }
+
+        for (Transfer* transfer : pad->transfers) {
+            if (transfer->submitted && transfer->cancelled) {
+                finish(transfer, PadTransferStatus::Cancelled, 0);
+            }
+        }
+
+        while (Transfer* transfer = oldestSubmitted(pad, false)) {
+            receivePacket(pad, transfer->buffer, transfer->length);
+            finish(transfer, PadTransferStatus::Completed, transfer->length);
+        }
+
+        while (pad->response_count > 0) {
+            Transfer* transfer = oldestSubmitted(pad, true);
+            if (transfer == nullptr) {
+                break;
+            }
+            Pad::Response& response = pad->responses[pad->response_head];
+            int size = response.length < transfer->length ? response.length : transfer->length;
+            memcpy(transfer->buffer, response.data, size);
+            pad->response_head = (pad->response_head + 1) % k_max_responses;
+            pad->response_count--;
+            finish(transfer, PadTransferStatus::Completed, size);
+        }
+
+        // A HID pad only reports when it's polled, so a poll with nothing submitted is simply missed
+        if (pad->report_interval_ns && now >= pad->next_report_ns) {
+            advanceInput(pad);
+            if (Transfer* transfer = oldestSubmitted(pad, true)) {
+                finish(transfer, PadTransferStatus::Completed, buildInputReport(pad, transfer->buffer, transfer->length));
+            }
+            pad->next_report_ns += pad->report_interval_ns;
+            if (pad->next_report_ns <= now) {
+                pad->next_report_ns = now + pad->report_interval_ns;
+            }
+        }
+
+        for (Transfer* transfer : pad->transfers) {
+            if (transfer->submitted && transfer->deadline_ns <= now) {
+                finish(transfer, PadTransferStatus::TimedOut, 0);
+            }
+        }
+    }
+
+    for (Transfer* transfer : ready_) {
+        transfer->callback(transfer);
+    }
+}
+
+void SimulatedTransport::advanceInput(Pad* pad) {
+    const LowLatencyDanceGameSDK::SimulatedPad& config = pad->config;
+    if (config.script && config.script_length > 0) {
+        pad->state = config.script[pad->script_position];
+        pad->script_position = (pad->script_position + 1) % config.script_length;
+        return;
+    }
+
+    // xorshift32
+    uint32_t x = pad->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pad->random_state = x;
+
+    if (static_cast<int>(x % 1000) < config.change_per_mille) {
+        int panel = (x >> 10) % 9;
+        pad->state ^= static_cast<uint16_t>(1 << panel);
+    }
+}
+
+int SimulatedTransport::buildInputReport(Pad* pad, uint8_t* buffer, int length) {
+    if (pad->config.kind == LowLatencyDanceGameSDK::SimulatedPad::Kind::SMX) {
+        if (length < 3) {
+            return 0;
+        }
+        buffer[0] = k_smx_report_input;
+        buffer[1] = pad->state & 0xFF;
+        buffer[2] = pad->state >> 8;
+        return 3;
+    }
+
+    if (pad->config.kind == LowLatencyDanceGameSDK::SimulatedPad::Kind::HID) {
+        if (length < k_hid_report_size) {
+            return 0;
+        }
+        uint16_t buttons = 0;
+        for (int button = 1; button <= 16; button++) {
+            DancePadAdapterInput input = hid_pad_button_input(button);
+            if (input != DancePadAdapterInputNone && (pad->state & input)) {
+                buttons |= static_cast<uint16_t>(1 << (button - 1));
+            }
+        }
+        buffer[0] = buttons & 0xFF;
+        buffer[1] = buttons >> 8;
+        return k_hid_report_size;
+    }
+
+    if (length < k_foam_report_size) {
+        return 0;
+    }
+    memset(buffer, 0, k_foam_report_size);
+
+    // The inverse of foam_input_converter
+    uint16_t state = pad->state;
+    if (state & DancePadAdapterInputLeft)      buffer[5] |= 0x40;
+    if (state & DancePadAdapterInputDown)      buffer[5] |= 0x20;
+    if (state & DancePadAdapterInputUp)        buffer[5] |= 0x10;
+    if (state & DancePadAdapterInputRight)     buffer[5] |= 0x80;
+    if (state & DancePadAdapterInputUpLeft)    buffer[6] |= 0x04;
+    if (state & DancePadAdapterInputUpRight)   buffer[6] |= 0x08;
+    if (state & DancePadAdapterInputDownLeft)  buffer[6] |= 0x01;
+    if (state & DancePadAdapterInputDownRight) buffer[6] |= 0x02;
+    if (state & DancePadAdapterInputStart)     buffer[6] |= 0x20;
+    if (state & DancePadAdapterInputSelect)    buffer[6] |= 0x10;
+    return k_foam_report_size;
+}
+
+void SimulatedTransport::receivePacket(Pad* pad, const uint8_t* packet, int length) {
+    if (pad->config.kind != LowLatencyDanceGameSDK::SimulatedPad::Kind::SMX ||
+        length < 3 || packet[0] != k_smx_report_command) {
+        return;
+    }
+
+    uint8_t flags = packet[1];
+    if (flags & k_smx_device_info) {
+        pad->probe_pending = pad->config.probe_delay_ms > 0;
+        if (pad->config.player >= 0 && pad->response_count < k_max_responses) {
+            Pad::Response& response = pad->responses[(pad->response_head + pad->response_count) % k_max_responses];
+            memset(response.data, 0, sizeof(response.data));
+            response.data[0] = k_smx_report_response;
+            response.data[1] = k_smx_device_info;
+            response.data[2] = 1;
+            response.data[3] = pad->config.player == 1 ? '1' : '0';
+            response.length = k_smx_packet_size;
+            pad->response_count++;
+        }
+        return;
+    }
+
+    if (flags & k_smx_start_of_command) {
+        pad->command_length = 0;
+    }
+    int size = packet[2];
+    if (size > length - 3) {
+        size = length - 3;
+    }
+    if (size > k_max_command_size - pad->command_length) {
+        size = k_max_command_size - pad->command_length;
+    }
+    memcpy(&pad->command[pad->command_length], &packet[3], size);
+    pad->command_length += size;
+
+    if (flags & k_smx_end_of_command) {
+        completeCommand(pad);
+    }
+}
+
+void SimulatedTransport::completeCommand(Pad* pad) {
+    const uint8_t* command = pad->command;
+    int length = pad->command_length;
+    pad->command_length = 0;
+    if (pad->config.on_command) {
+        pad->config.on_command(command, static_cast<size_t>(length), pad->config.on_command_user_data);
+    }
+
+    if (length >= 2 && command[0] == 'y') {
+        sendSensorTestData(pad, command[1]);
+        return;
+    }
+    if (length >= 1 && command[0] == 'G') {
+        uint8_t payload[2 + k_smx_config_size];
+        payload[0] = 'G';
+        payload[1] = static_cast<uint8_t>(k_smx_config_size);
+        memcpy(&payload[2], pad->stage_config, k_smx_config_size);
+        queueResponse(pad, payload, sizeof(payload));
+        return;
+    }
+    if (length >= 2 && command[0] == 'W') {
+        int size = command[1] < length - 2 ? command[1] : length - 2;
+        if (size > k_smx_config_size) {
+            size = k_smx_config_size;
+        }
+        memcpy(pad->stage_config, &command[2], size);
+    } else if (length >= 1 && command[0] == 'f') {
+        resetStageConfig(pad);
+    }
+
+    // Lights and other commands have no visible effect here; the pad just says it's done
+    queueResponse(pad, nullptr, 0);
+}
+
+// Factory settings: only the master and config versions are filled in
+void SimulatedTransport::resetStageConfig(Pad* pad) {
+    memset(pad->stage_config, 0, sizeof(pad->stage_config));
+    pad->stage_config[0] = 0x05;
+    pad->stage_config[1] = 0x05;
+}
+
+// Queues `length` bytes of command response, split into as many packets as it takes, and marks the
+// command done in the last one. Nothing is queued if it wouldn't all fit, as if the pad were busy.
+void SimulatedTransport::queueResponse(Pad* pad, const uint8_t* payload, int length) {
+    const int chunk_size = k_smx_packet_size - 3;
+    int packets = length > 0 ? (length + chunk_size - 1) / chunk_size : 1;
+    if (pad->response_count + packets > k_max_responses) {
+        return;
+    }
+
+    for (int i = 0; i < packets; i++) {
+        int offset = i * chunk_size;
+        int size = length - offset < chunk_size ? length - offset : chunk_size;
+        Pad::Response& response = pad->responses[(pad->response_head + pad->response_count) % k_max_responses];
+        memset(response.data, 0, sizeof(response.data));
+        response.data[0] = k_smx_report_response;
+        if (length > 0 && i == 0) {
+            response.data[1] |= k_smx_start_of_command;
+        }
+        if (i == packets - 1) {
+            response.data[1] |= k_smx_host_cmd_done | (length > 0 ? k_smx_end_of_command : 0);
+        }
+        response.data[2] = static_cast<uint8_t>(size);
+        if (size > 0) {
+            memcpy(&response.data[3], &payload[offset], size);
+        }
+        response.length = k_smx_packet_size;
+        pad->response_count++;
+    }
+}
+
+// Answers a sensor test request ("y" and the mode) the way a stage does: each panel's reading is an
+// 11-byte record, sent one bit at a time with bit n of every 16-bit word belonging to panel n.
+// Pressed panels read high, the rest sit near zero.
+void SimulatedTransport::sendSensorTestData(Pad* pad, uint8_t mode) {
+    uint8_t records[k_smx_panel_count][10]; // The pad's packed record, as SMX_GetTestData reads it
+    for (int panel = 0; panel < k_smx_panel_count; panel++) {
+        uint8_t* record = records[panel];
+        memset(record, 0, sizeof(records[panel]));
+        record[0] = 0x02; // The 0, 1, 0 signature that marks a test data record
+
+        int16_t level = (pad->state & (1 << panel)) ? 800 : 10;
+        for (int sensor = 0; sensor < 4; sensor++) {
+            int16_t value = static_cast<int16_t>(level + sensor);
+            record[1 + sensor * 2] = static_cast<uint8_t>(value & 0xFF);
+            record[2 + sensor * 2] = static_cast<uint8_t>((value >> 8) & 0xFF);
+        }
+        record[9] = static_cast<uint8_t>(panel & 0x0F); // DIP switches
+        if (panel == 4) {
+            record[9] |= 0x10; // The center panel reports a bad jumper on its first sensor
+        }
+    }
+
+    const int bits = sizeof(records[0]) * 8;
+    uint8_t payload[3 + bits * 2];
+    payload[0] = 'y';
+    payload[1] = mode;
+    payload[2] = static_cast<uint8_t>(bits);
+    for (int bit = 0; bit < bits; bit++) {
+        uint16_t word = 0;
+        for (int panel = 0; panel < k_smx_panel_count; panel++) {
+            if (records[panel][bit / 8] & (1 << (bit % 8))) {
+                word |= static_cast<uint16_t>(1 << panel);
+            }
+        }
+        payload[3 + bit * 2] = static_cast<uint8_t>(word & 0xFF);
+        payload[4 + bit * 2] = static_cast<uint8_t>(word >> 8);
+    }
+    queueResponse(pad, payload, sizeof(payload));
+}
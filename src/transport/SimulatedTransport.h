@@ -0,0 +1,71 @@
+#ifndef LLDGSDK_SIMULATEDTRANSPORT_H
+#define LLDGSDK_SIMULATEDTRANSPORT_H
+
+#include "PadTransport.h"
+#include "lowlatencydancegamesdk.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+// Stand-in for the USB stack that emulates SMX and foam pads in software. Reports come out in each pad's
+// real wire format at the configured rate, and SMX pads answer player-ID requests and acknowledge commands,
+// so the SDK can be exercised and benchmarked at thousands of Hz without hardware.
+class SimulatedTransport : public PadTransport {
+public:
+    SimulatedTransport(const LowLatencyDanceGameSDK::SimulatedPad* pads, int pad_count);
+    ~SimulatedTransport() override;
+
+    bool start() override;
+    void stop() override;
+
+    bool listDevices(std::vector<PadDeviceInfo>& devices) override;
+    void releaseDevices(std::vector<PadDeviceInfo>& devices) override;
+
+    PadConnection* open(const PadDeviceInfo& device, const PadConnection* known) override;
+    void close(PadConnection* connection) override;
+
+    int interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                          int* transferred, unsigned int timeout_ms) override;
+    int getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) override;
+    int readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) override;
+
+    PadTransfer* allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                               unsigned int timeout_ms, PadTransferCallback callback, void* user_data) override;
+    void freeTransfer(PadTransfer* transfer) override;
+    bool submitTransfer(PadTransfer* transfer) override;
+    void cancelTransfer(PadTransfer* transfer) override;
+
+    void handleEvents(uint64_t timeout_ns) override;
+    void interruptEvents() override;
+
+    bool watchArrivals() override;
+    bool takeArrivals() override;
+
+private:
+    struct Pad;
+    struct Transfer;
+
+    uint64_t nextEventTime(uint64_t now);
+    void runDue(uint64_t now);
+    void finish(Transfer* transfer, PadTransferStatus status, int actual_length);
+    Transfer* oldestSubmitted(Pad* pad, bool input);
+
+    static void advanceInput(Pad* pad);
+    static int buildInputReport(Pad* pad, uint8_t* buffer, int length);
+    static void receivePacket(Pad* pad, const uint8_t* packet, int length);
+    static void completeCommand(Pad* pad);
+    static void queueResponse(Pad* pad, const uint8_t* payload, int length);
+    static void sendSensorTestData(Pad* pad, uint8_t mode);
+    static void resetStageConfig(Pad* pad);
+
+    std::vector<std::unique_ptr<Pad>> pads_;
+    std::vector<Transfer*> ready_; // Completions gathered before their callbacks run
+    uint64_t submit_counter_ = 0;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool woken_ = false;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LLDGSDK_SYSFSREPORTDESCRIPTOR_H
+#define LLDGSDK_SYSFSREPORTDESCRIPTOR_H
+
+#ifdef __linux__
+
+#include "PadTransport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <dirent.h>
+
+// Reads the report descriptor of `device.hid_interface` from sysfs, where the kernel publishes it for
+// every interface its HID driver has bound: /sys/bus/usb/devices/<device>/<device>:<config>.<interface>/
+// <bus>:<vendor>:<product>.<n>/report_descriptor. Returns its length, or -1 if there's no HID driver on
+// the interface (or no sysfs).
+inline int readSysfsReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) {
+    if (device.port_path_length <= 0) {
+        return -1;
+    }
+    // Device directories are named <bus>-<port>.<port>...
+    char name[64];
+    int used = snprintf(name, sizeof(name), "%d-", device.bus_number);
+    for (int i = 0; i < device.port_path_length; i++) {
+        used += snprintf(name + used, sizeof(name) - used, i ? ".%d" : "%d", device.port_path[i]);
+    }
+    std::string device_path = std::string("/sys/bus/usb/devices/") + name;
+
+    // Only the active configuration's interfaces are listed
+    std::string interface_path;
+    DIR* dir = opendir(device_path.c_str());
+    if (!dir) {
+        return -1;
+    }
+    size_t name_length = strlen(name);
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, name, name_length) != 0 || entry->d_name[name_length] != ':') {
+            continue;
+        }
+        const char* number = strchr(entry->d_name + name_length, '.');
+        char* end;
+        if (number && strtoul(number + 1, &end, 10) == device.hid_interface && end != number + 1 && *end == '\0') {
+            interface_path = device_path + "/" + entry->d_name;
+            break;
+        }
+    }
+    closedir(dir);
+    if (interface_path.empty()) {
+        return -1;
+    }
+
+    // The HID device is the one child with a report descriptor
+    int result = -1;
+    dir = opendir(interface_path.c_str());
+    if (!dir) {
+        return -1;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        FILE* file = fopen((interface_path + "/" + entry->d_name + "/report_descriptor").c_str(), "rb");
+        if (!file) {
+            continue;
+        }
+        size_t read = fread(buffer, 1, static_cast<size_t>(length), file);
+        fclose(file);
+        if (read > 0) {
+            result = static_cast<int>(read);
+            break;
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,540 @@
+#ifdef __linux__
+
+#include "UsbfsTransport.h"
+#include "SysfsReportDescriptor.h"
+#include "../MonotonicClock.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+// Where listDevices() found a device, kept in PadDeviceInfo::native until releaseDevices()
+struct UsbfsDeviceEntry {
+    int configuration = 0; // Active configuration value from sysfs
+};
+
+struct UsbfsPadTransfer;
+
+struct UsbfsConnection : PadConnection {
+    int fd = -1;
+    bool detached_kernel_driver = false; // Hand the interface back to the OS on close
+    bool gone = false;                   // Unplugged; taken out of the epoll set
+    bool registered = false;             // In connections_ and the epoll set, which only the event thread touches
+    std::vector<UsbfsPadTransfer*> transfers; // Allocated on this connection, for timeouts
+};
+
+struct UsbfsPadTransfer : PadTransfer {
+    UsbfsConnection* connection = nullptr;
+    unsigned int timeout_ms = 0;
+    uint64_t deadline_ns = 0;
+    bool submitted = false;
+    bool timed_out = false;
+    usbdevfs_urb* urb = nullptr; // Allocated with the transfer and reused for every submission
+};
+
+static bool readSysfsNumber(const std::string& path, int base, unsigned long* value) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    char text[32];
+    bool ok = fgets(text, sizeof(text), file) != nullptr;
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    char* end;
+    *value = strtoul(text, &end, base);
+    return end != text;
+}
+
+// Device directories are named <bus>-<port>.<port>...; interfaces have a ':' and root hubs start with "usb"
+static bool parsePortPath(const char* name, PadDeviceInfo& info) {
+    const char* ports = strchr(name, '-');
+    if (!ports || strchr(name, ':')) {
+        return false;
+    }
+    info.port_path_length = 0;
+    for (const char* p = ports + 1; *p;) {
+        char* end;
+        unsigned long port = strtoul(p, &end, 10);
+        if (end == p || info.port_path_length == static_cast<int>(sizeof(info.port_path))) {
+            return false;
+        }
+        info.port_path[info.port_path_length++] = static_cast<uint8_t>(port);
+        p = (*end == '.') ? end + 1 : end;
+        if (*end != '.' && *end != '\0') {
+            return false;
+        }
+    }
+    return info.port_path_length > 0;
+}
+
+// Picks the interface a device is opened on: its first HID interface that isn't a boot keyboard or mouse,
+// or failing that its first HID interface of any kind. Returns whether it found one of the first sort.
+static bool findHIDCandidate(const std::string& device_path, const char* name, uint8_t* hid_interface) {
+    DIR* dir = opendir(device_path.c_str());
+    if (!dir) {
+        return false;
+    }
+    // Directory order is arbitrary, so keep the lowest-numbered of each sort
+    unsigned long candidate = 256, any = 256;
+    size_t name_length = strlen(name);
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, name, name_length) != 0 || entry->d_name[name_length] != ':') {
+            continue;
+        }
+        std::string interface_path = device_path + "/" + entry->d_name;
+        unsigned long interface_class, interface_protocol, interface_number;
+        if (!readSysfsNumber(interface_path + "/bInterfaceClass", 16, &interface_class) || interface_class != 3 ||
+            !readSysfsNumber(interface_path + "/bInterfaceNumber", 16, &interface_number) ||
+            !readSysfsNumber(interface_path + "/bInterfaceProtocol", 16, &interface_protocol)) {
+            continue;
+        }
+        if (interface_protocol == 0 && interface_number < candidate) {
+            candidate = interface_number;
+        }
+        if (interface_number < any) {
+            any = interface_number;
+        }
+    }
+    closedir(dir);
+    if (candidate < 256) {
+        *hid_interface = static_cast<uint8_t>(candidate);
+        return true;
+    }
+    if (any < 256) {
+        *hid_interface = static_cast<uint8_t>(any);
+    }
+    return false;
+}
+
+UsbfsTransport::~UsbfsTransport() {
+    stop();
+}
+
+bool UsbfsTransport::start() {
+    if (epoll_fd_ >= 0) {
+        return true;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0 || !wake_.open()) {
+        stop();
+        return false;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // The wake descriptor; everything else is a connection
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_.fd(), &event) != 0) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void UsbfsTransport::stop() {
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    wake_.close();
+}
+
+bool UsbfsTransport::listDevices(std::vector<PadDeviceInfo>& devices) {
+    const std::string root = "/sys/bus/usb/devices";
+    DIR* dir = opendir(root.c_str());
+    if (!dir) {
+        return false;
+    }
+
+    while (dirent* entry = readdir(dir)) {
+        PadDeviceInfo info;
+        if (!parsePortPath(entry->d_name, info)) {
+            continue;
+        }
+
+        std::string path = root + "/" + entry->d_name;
+        unsigned long vendor_id, product_id, bus_number, device_address, configuration;
+        if (!readSysfsNumber(path + "/idVendor", 16, &vendor_id) ||
+            !readSysfsNumber(path + "/idProduct", 16, &product_id) ||
+            !readSysfsNumber(path + "/busnum", 10, &bus_number) ||
+            !readSysfsNumber(path + "/devnum", 10, &device_address)) {
+            continue;
+        }
+        if (!readSysfsNumber(path + "/bConfigurationValue", 10, &configuration)) {
+            configuration = 0; // Unconfigured
+        }
+
+        info.vendor_id = static_cast<uint16_t>(vendor_id);
+        info.product_id = static_cast<uint16_t>(product_id);
+        info.bus_number = static_cast<uint8_t>(bus_number);
+        info.device_address = static_cast<uint8_t>(device_address);
+        info.hid_candidate = findHIDCandidate(path, entry->d_name, &info.hid_interface);
+
+        UsbfsDeviceEntry* device_entry = new UsbfsDeviceEntry();
+        device_entry->configuration = static_cast<int>(configuration);
+        info.native = device_entry;
+        devices.push_back(info);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+void UsbfsTransport::releaseDevices(std::vector<PadDeviceInfo>& devices) {
+    for (PadDeviceInfo& info : devices) {
+        delete static_cast<UsbfsDeviceEntry*>(info.native);
+    }
+    devices.clear();
+}
+
+// Walks the active configuration in the descriptors read from a device node for HID interface
+// `interface_number` and that interface's interrupt endpoints
+static bool findHIDInterface(int fd, int configuration, uint8_t interface_number, PadConnection* layout) {
+    // Reading the node gives the device descriptor followed by every configuration's descriptors
+    uint8_t descriptors[4096];
+    ssize_t length = read(fd, descriptors, sizeof(descriptors));
+    if (length < 18) {
+        return false;
+    }
+
+    bool in_active_config = false;
+    bool in_hid_interface = false;
+    bool found_interface = false;
+    for (ssize_t offset = 18; offset + 2 <= length;) {
+        uint8_t descriptor_length = descriptors[offset];
+        uint8_t descriptor_type = descriptors[offset + 1];
+        if (descriptor_length < 2 || offset + descriptor_length > length) {
+            break;
+        }
+        const uint8_t* d = &descriptors[offset];
+
+        if (descriptor_type == 2 && descriptor_length >= 9) {
+            // Configuration; an unconfigured device falls back to its first one
+            in_active_config = d[5] == configuration || configuration == 0;
+            in_hid_interface = false;
+        } else if (descriptor_type == 4 && descriptor_length >= 9 && in_active_config) {
+            // Interface
+            in_hid_interface = !found_interface && d[2] == interface_number && d[3] == 0 && d[5] == 3;
+            if (in_hid_interface) {
+                layout->hid_interface = d[2];
+                found_interface = true;
+            }
+        } else if (descriptor_type == 5 && descriptor_length >= 7 && in_hid_interface) {
+            // Endpoint
+            uint8_t address = d[2];
+            bool is_interrupt = (d[3] & 0x03) == 0x03;
+            int packet_size = (d[4] | (d[5] << 8)) & 0x7FF; // Bits 11-12 are the high-bandwidth multiplier
+            if (is_interrupt && (address & 0x80) && layout->interrupt_in_endpoint == 0) {
+                layout->interrupt_in_endpoint = address;
+                layout->in_packet_size = packet_size;
+            }
+            if (is_interrupt && !(address & 0x80) && layout->interrupt_out_endpoint == 0) {
+                layout->interrupt_out_endpoint = address;
+                layout->out_packet_size = packet_size;
+            }
+        }
+        offset += descriptor_length;
+    }
+    return found_interface && layout->interrupt_in_endpoint != 0;
+}
+
+PadConnection* UsbfsTransport::open(const PadDeviceInfo& device, const PadConnection* known) {
+    const UsbfsDeviceEntry* entry = static_cast<const UsbfsDeviceEntry*>(device.native);
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/bus/usb/%03d/%03d", device.bus_number, device.device_address);
+    int fd = ::open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    PadConnection layout;
+    if (known) {
+        layout = *known;
+    } else if (!findHIDInterface(fd, entry->configuration, device.hid_interface, &layout)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    UsbfsConnection* connection = new UsbfsConnection();
+    static_cast<PadConnection&>(*connection) = layout;
+    connection->fd = fd;
+
+    // Take the interface from whichever kernel driver has it (usually usbhid), unless another program does
+    usbdevfs_getdriver driver = {};
+    driver.interface = connection->hid_interface;
+    if (ioctl(fd, USBDEVFS_GETDRIVER, &driver) == 0) {
+        if (strcmp(driver.driver, "usbfs") == 0) {
+            ::close(fd);
+            delete connection;
+            return nullptr;
+        }
+        usbdevfs_ioctl command = {};
+        command.ifno = connection->hid_interface;
+        command.ioctl_code = USBDEVFS_DISCONNECT;
+        if (ioctl(fd, USBDEVFS_IOCTL, &command) < 0) {
+            ::close(fd);
+            delete connection;
+            return nullptr;
+        }
+        connection->detached_kernel_driver = true;
+    }
+
+    unsigned int interface_number = connection->hid_interface;
+    if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &interface_number) < 0) {
+        if (connection->detached_kernel_driver) {
+            usbdevfs_ioctl command = {};
+            command.ifno = connection->hid_interface;
+            command.ioctl_code = USBDEVFS_CONNECT;
+            ioctl(fd, USBDEVFS_IOCTL, &command);
+        }
+        ::close(fd);
+        delete connection;
+        return nullptr;
+    }
+
+    // The connection joins the event loop with its first async transfer; until then it's only this thread's
+    return connection;
+}
+
+// Runs on the event thread
+bool UsbfsTransport::registerConnection(UsbfsConnection* connection) {
+    // usbfs reports reapable URBs as writable
+    epoll_event event = {};
+    event.events = EPOLLOUT;
+    event.data.ptr = connection;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, connection->fd, &event) != 0) {
+        return false;
+    }
+    connections_.push_back(connection);
+    connection->registered = true;
+    return true;
+}
+
+void UsbfsTransport::close(PadConnection* connection) {
+    UsbfsConnection* usbfs_connection = static_cast<UsbfsConnection*>(connection);
+    if (usbfs_connection->registered) {
+        for (size_t i = 0; i < connections_.size(); i++) {
+            if (connections_[i] == usbfs_connection) {
+                connections_.erase(connections_.begin() + i);
+                break;
+            }
+        }
+        if (!usbfs_connection->gone) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, usbfs_connection->fd, nullptr);
+        }
+    }
+
+    unsigned int interface_number = usbfs_connection->hid_interface;
+    ioctl(usbfs_connection->fd, USBDEVFS_RELEASEINTERFACE, &interface_number);
+    if (usbfs_connection->detached_kernel_driver) {
+        usbdevfs_ioctl command = {};
+        command.ifno = usbfs_connection->hid_interface;
+        command.ioctl_code = USBDEVFS_CONNECT;
+        ioctl(usbfs_connection->fd, USBDEVFS_IOCTL, &command);
+    }
+    ::close(usbfs_connection->fd);
+    delete usbfs_connection;
+}
+
+int UsbfsTransport::interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                                      int* transferred, unsigned int timeout_ms) {
+    // Probes run on their own threads, so this just blocks; usbfs runs interrupt endpoints through BULK too
+    UsbfsConnection* usbfs_connection = static_cast<UsbfsConnection*>(connection);
+    usbdevfs_bulktransfer bulk = {};
+    bulk.ep = endpoint;
+    bulk.len = static_cast<unsigned int>(length);
+    bulk.timeout = timeout_ms;
+    bulk.data = data;
+    int result = ioctl(usbfs_connection->fd, USBDEVFS_BULK, &bulk);
+    if (transferred) {
+        *transferred = result > 0 ? result : 0;
+    }
+    return result < 0 ? -errno : 0;
+}
+
+int UsbfsTransport::getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) {
+    UsbfsConnection* usbfs_connection = static_cast<UsbfsConnection*>(connection);
+    usbdevfs_ctrltransfer control = {};
+    control.bRequestType = 0x81; // Device to host, standard, interface
+    control.bRequest = 0x06;     // GET_DESCRIPTOR
+    control.wValue = 0x22 << 8;  // Report descriptor
+    control.wIndex = usbfs_connection->hid_interface;
+    control.wLength = static_cast<uint16_t>(length);
+    control.timeout = 1000;
+    control.data = buffer;
+    int result = ioctl(usbfs_connection->fd, USBDEVFS_CONTROL, &control);
+    return result < 0 ? -errno : result;
+}
+
+int UsbfsTransport::readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) {
+    return readSysfsReportDescriptor(device, buffer, length);
+}
+
+PadTransfer* UsbfsTransport::allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                                           unsigned int timeout_ms, PadTransferCallback callback, void* user_data) {
+    UsbfsConnection* usbfs_connection = static_cast<UsbfsConnection*>(connection);
+    if (!usbfs_connection->registered && !registerConnection(usbfs_connection)) {
+        return nullptr;
+    }
+
+    UsbfsPadTransfer* transfer = new UsbfsPadTransfer();
+    transfer->endpoint = endpoint;
+    transfer->buffer = buffer;
+    transfer->length = length;
+    transfer->callback = callback;
+    transfer->user_data = user_data;
+    transfer->connection = static_cast<UsbfsConnection*>(connection);
+    transfer->timeout_ms = timeout_ms;
+
+    // The URB ends in a flexible array for isochronous packets, which interrupt transfers don't use
+    transfer->urb = static_cast<usbdevfs_urb*>(calloc(1, sizeof(usbdevfs_urb)));
+    if (!transfer->urb) {
+        delete transfer;
+        return nullptr;
+    }
+    transfer->urb->type = USBDEVFS_URB_TYPE_INTERRUPT;
+    transfer->urb->endpoint = endpoint;
+    transfer->urb->buffer = buffer;
+    transfer->urb->buffer_length = length;
+    transfer->urb->usercontext = transfer;
+    transfer->connection->transfers.push_back(transfer);
+    return transfer;
+}
+
+void UsbfsTransport::freeTransfer(PadTransfer* transfer) {
+    UsbfsPadTransfer* usbfs_transfer = static_cast<UsbfsPadTransfer*>(transfer);
+    std::vector<UsbfsPadTransfer*>& transfers = usbfs_transfer->connection->transfers;
+    for (size_t i = 0; i < transfers.size(); i++) {
+        if (transfers[i] == usbfs_transfer) {
+            transfers.erase(transfers.begin() + i);
+            break;
+        }
+    }
+    free(usbfs_transfer->urb);
+    delete usbfs_transfer;
+}
+
+bool UsbfsTransport::submitTransfer(PadTransfer* transfer) {
+    UsbfsPadTransfer* usbfs_transfer = static_cast<UsbfsPadTransfer*>(transfer);
+    if (usbfs_transfer->connection->gone) {
+        return false;
+    }
+    usbfs_transfer->urb->status = 0;
+    usbfs_transfer->urb->actual_length = 0;
+    if (ioctl(usbfs_transfer->connection->fd, USBDEVFS_SUBMITURB, usbfs_transfer->urb) < 0) {
+        return false;
+    }
+    usbfs_transfer->submitted = true;
+    usbfs_transfer->timed_out = false;
+    usbfs_transfer->deadline_ns = usbfs_transfer->timeout_ms
+        ? monotonicNanoseconds() + static_cast<uint64_t>(usbfs_transfer->timeout_ms) * 1000000 : 0;
+    return true;
+}
+
+void UsbfsTransport::cancelTransfer(PadTransfer* transfer) {
+    UsbfsPadTransfer* usbfs_transfer = static_cast<UsbfsPadTransfer*>(transfer);
+    if (usbfs_transfer->submitted) {
+        // Fails harmlessly if the URB already completed; it's reaped either way
+        ioctl(usbfs_transfer->connection->fd, USBDEVFS_DISCARDURB, usbfs_transfer->urb);
+    }
+}
+
+void UsbfsTransport::reap(UsbfsConnection* connection) {
+    usbdevfs_urb* urb;
+    while (ioctl(connection->fd, USBDEVFS_REAPURBNDELAY, &urb) == 0) {
+        UsbfsPadTransfer* transfer = static_cast<UsbfsPadTransfer*>(urb->usercontext);
+        transfer->submitted = false;
+        if (transfer->timed_out) {
+            transfer->status = PadTransferStatus::TimedOut;
+        } else if (urb->status == 0) {
+            transfer->status = PadTransferStatus::Completed;
+        } else if (urb->status == -ENOENT || urb->status == -ECONNRESET) {
+            transfer->status = PadTransferStatus::Cancelled;
+        } else if (urb->status == -ENODEV || urb->status == -ESHUTDOWN) {
+            transfer->status = PadTransferStatus::NoDevice;
+        } else {
+            transfer->status = PadTransferStatus::Error;
+        }
+        transfer->actual_length = urb->actual_length;
+        transfer->callback(transfer);
+    }
+}
+
+// usbfs URBs have no timeout of their own, so ones past their deadline are discarded and reported as timed out
+uint64_t UsbfsTransport::expireTimeouts(uint64_t now_ns) {
+    uint64_t next_deadline_ns = UINT64_MAX;
+    for (UsbfsConnection* connection : connections_) {
+        for (UsbfsPadTransfer* transfer : connection->transfers) {
+            if (!transfer->submitted || transfer->timed_out || transfer->deadline_ns == 0) {
+                continue;
+            }
+            if (now_ns >= transfer->deadline_ns) {
+                transfer->timed_out = true;
+                ioctl(connection->fd, USBDEVFS_DISCARDURB, transfer->urb);
+            } else if (transfer->deadline_ns < next_deadline_ns) {
+                next_deadline_ns = transfer->deadline_ns;
+            }
+        }
+    }
+    return next_deadline_ns;
+}
+
+void UsbfsTransport::handleEvents(uint64_t timeout_ns) {
+    uint64_t now = monotonicNanoseconds();
+    uint64_t deadline = expireTimeouts(now);
+    if (deadline != UINT64_MAX) {
+        uint64_t until = deadline > now ? deadline - now : 0;
+        if (until < timeout_ns) {
+            timeout_ns = until;
+        }
+    }
+
+    // Round up, so a wait for a deadline doesn't wake just before it
+    int timeout_ms = static_cast<int>((timeout_ns + 999999) / 1000000);
+    epoll_event events[16];
+    int count = epoll_wait(epoll_fd_, events, 16, timeout_ms);
+    for (int i = 0; i < count; i++) {
+        UsbfsConnection* connection = static_cast<UsbfsConnection*>(events[i].data.ptr);
+        if (!connection) {
+            wake_.clear();
+            continue;
+        }
+        reap(connection);
+        if ((events[i].events & (EPOLLHUP | EPOLLERR)) && !connection->gone) {
+            // Unplugged: everything still in flight has just been reaped, and the descriptor would
+            // otherwise stay ready until the SDK gets round to closing it
+            connection->gone = true;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+        }
+    }
+    // Anything an unplugged pad still had in flight can only be found by asking
+    for (UsbfsConnection* connection : connections_) {
+        if (connection->gone) {
+            reap(connection);
+        }
+    }
+    expireTimeouts(monotonicNanoseconds());
+}
+
+void UsbfsTransport::interruptEvents() {
+    wake_.signal();
+}
+
+bool UsbfsTransport::watchArrivals() {
+    return false;
+}
+
+bool UsbfsTransport::takeArrivals() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef LLDGSDK_USBFSTRANSPORT_H
+#define LLDGSDK_USBFSTRANSPORT_H
+
+#ifdef __linux__
+
+#include "PadTransport.h"
+#include "../NotifyFd.h"
+
+struct UsbfsConnection;
+
+// Linux only. Drives pads through their /dev/bus/usb nodes with usbfs ioctls directly: URBs are submitted
+// and reaped by the event thread itself, which sleeps in epoll_wait on the device descriptors, so a
+// completion wakes it with no library locking or timer handling in between. Opening and probe transfers are
+// plain blocking ioctls on the pad's own descriptor, so they can run on probe threads; a connection only joins
+// the epoll set when the event thread allocates its first async transfer. Devices are enumerated from sysfs.
+// New pads are found by the SDK's periodic rescan rather than hotplug events.
+class UsbfsTransport : public PadTransport {
+public:
+    ~UsbfsTransport() override;
+
+    bool start() override;
+    void stop() override;
+
+    bool listDevices(std::vector<PadDeviceInfo>& devices) override;
+    void releaseDevices(std::vector<PadDeviceInfo>& devices) override;
+
+    PadConnection* open(const PadDeviceInfo& device, const PadConnection* known) override;
+    void close(PadConnection* connection) override;
+
+    int interruptTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* data, int length,
+                          int* transferred, unsigned int timeout_ms) override;
+    int getReportDescriptor(PadConnection* connection, uint8_t* buffer, int length) override;
+    int readReportDescriptor(const PadDeviceInfo& device, uint8_t* buffer, int length) override;
+
+    PadTransfer* allocTransfer(PadConnection* connection, uint8_t endpoint, uint8_t* buffer, int length,
+                               unsigned int timeout_ms, PadTransferCallback callback, void* user_data) override;
+    void freeTransfer(PadTransfer* transfer) override;
+    bool submitTransfer(PadTransfer* transfer) override;
+    void cancelTransfer(PadTransfer* transfer) override;
+
+    void handleEvents(uint64_t timeout_ns) override;
+    void interruptEvents() override;
+
+    bool watchArrivals() override;
+    bool takeArrivals() override;
+
+private:
+    bool registerConnection(UsbfsConnection* connection);
+    void reap(UsbfsConnection* connection);
+    uint64_t expireTimeouts(uint64_t now_ns);
+
+    int epoll_fd_ = -1;
+    NotifyFd wake_;
+    std::vector<UsbfsConnection*> connections_;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+# Fails unless every symbol LIBRARY exports matches PATTERN. Run with
+#   cmake -DNM=<nm> -DLIBRARY=<shared library> -DPATTERN=<regex> -P check_exports.cmake
+
+execute_process(COMMAND "${NM}" -D --defined-only "${LIBRARY}"
+                OUTPUT_VARIABLE symbols
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${NM} couldn't read ${LIBRARY}")
+endif()
+
+string(REPLACE "\n" ";" lines "${symbols}")
+set(exported 0)
+set(unexpected "")
+foreach(line IN LISTS lines)
+  # <address> <type> <name>
+  if(line MATCHES "^[0-9a-fA-F]+ [A-Za-z] (.+)$")
+    set(name "${CMAKE_MATCH_1}")
+    if(name MATCHES "${PATTERN}")
+      math(EXPR exported "${exported} + 1")
+    else()
+      list(APPEND unexpected "${name}")
+    endif()
+  endif()
+endforeach()
+
+if(unexpected)
+  string(REPLACE ";" "\n  " unexpected "${unexpected}")
+  message(FATAL_ERROR "${LIBRARY} exports symbols outside ${PATTERN}:\n  ${unexpected}")
+endif()
+if(exported EQUAL 0)
+  message(FATAL_ERROR "${LIBRARY} exports nothing matching ${PATTERN}")
+endif()
+message(STATUS "${LIBRARY}: ${exported} exports, all matching ${PATTERN}")
@@ -0,0 +1,109 @@
+// Tests for generic HID pads (pads with no adapter, set up from their report descriptor), run against
+// simulated pads: they're left alone unless Options::generic_hid is set, and when it is they never take a
+// slot from a pad with an adapter of its own. Exits with status 1 if a check fails.
+
+#include "lowlatencydancegamesdk.h"
+#include "MonotonicClock.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+extern "C" {
+    #include "adapters/AdapterBase.h"
+}
+
+using SDK = LowLatencyDanceGameSDK;
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static const uint16_t k_hid_state = DancePadAdapterInputLeft;
+static const uint16_t k_smx_state = DancePadAdapterInputUp;
+static const uint16_t k_foam_state = DancePadAdapterInputRight;
+
+static void noInput(SDK::Player, uint16_t, void*) {
+}
+
+// Polls until `player` reports `state`, for up to a second
+static bool waitForState(SDK::Player player, uint16_t state) {
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    while (SDK::getInstance().getPlayerButtonState(player) != state) {
+        if (monotonicNanoseconds() >= deadline_ns) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static SDK::Options simulatedOptions(const SDK::SimulatedPad* pads, int pad_count) {
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = pads;
+    options.simulated_pad_count = pad_count;
+    options.thread.scheduling = SDK::ThreadOptions::Scheduling::Normal;
+    return options;
+}
+
+// A HID gamepad on its own isn't used unless asked for
+static void testOffByDefault() {
+    SDK::SimulatedPad pad;
+    pad.kind = SDK::SimulatedPad::Kind::HID;
+    pad.script = &k_hid_state;
+    pad.script_length = 1;
+
+    SDK::Options options = simulatedOptions(&pad, 1);
+    CHECK(!options.generic_hid);
+    CHECK(!SDK::getInstance().initialize(noInput, nullptr, options));
+    SDK::getInstance().shutdown();
+
+    options.generic_hid = true;
+    CHECK(SDK::getInstance().initialize(noInput, nullptr, options));
+    CHECK(waitForState(SDK::Player::P1, k_hid_state));
+    SDK::getInstance().shutdown();
+}
+
+// With two slots and three candidates, the HID gamepad on the first port is the one left out, even though
+// the slots go by USB port order
+static void testAdapterPadsFirst() {
+    SDK::SimulatedPad pads[3];
+    pads[0].kind = SDK::SimulatedPad::Kind::HID;
+    pads[0].port_path[0] = 1;
+    pads[0].script = &k_hid_state;
+    pads[0].script_length = 1;
+    pads[1].kind = SDK::SimulatedPad::Kind::SMX;
+    pads[1].port_path[0] = 2;
+    pads[1].script = &k_smx_state;
+    pads[1].script_length = 1;
+    pads[2].kind = SDK::SimulatedPad::Kind::Foam;
+    pads[2].port_path[0] = 3;
+    pads[2].script = &k_foam_state;
+    pads[2].script_length = 1;
+
+    SDK::Options options = simulatedOptions(pads, 3);
+    options.generic_hid = true;
+    options.max_devices = 2;
+    CHECK(SDK::getInstance().initialize(noInput, nullptr, options));
+    CHECK(waitForState(SDK::Player::P1, k_smx_state));
+    CHECK(waitForState(SDK::Player::P2, k_foam_state));
+    SDK::getInstance().shutdown();
+}
+
+int main() {
+    testOffByDefault();
+    testAdapterPadsFirst();
+    if (g_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("generic_hid: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Tests for the lights pipeline, run against a simulated SMX pad that notes every frame it receives:
+// frames never reach the pad closer together than Options::lights_min_interval_us, and frames submitted
+// faster than they can go out collapse to the newest one, and input reports keep arriving at the same rate
+// while lights are sent. Exits with status 1 if a check fails.
+
+#include "lowlatencydancegamesdk.h"
+#include "MonotonicClock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using SDK = LowLatencyDanceGameSDK;
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+// Not a real SMX command; the simulated pad acks it like any other. The two bytes after it number the frame.
+static const uint8_t k_frame_command = 'L';
+
+struct ReceivedFrame {
+    uint64_t arrival_ns;
+    int number;
+};
+
+static std::mutex g_received_mutex;
+static std::vector<ReceivedFrame> g_received;
+
+static void onCommand(const uint8_t* command, size_t length, void*) {
+    if (length == 3 && command[0] == k_frame_command) {
+        std::lock_guard<std::mutex> lock(g_received_mutex);
+        g_received.push_back({monotonicNanoseconds(), command[1] | (command[2] << 8)});
+    }
+}
+
+static std::vector<ReceivedFrame> received() {
+    std::lock_guard<std::mutex> lock(g_received_mutex);
+    return g_received;
+}
+
+static void noInput(SDK::Player, uint16_t, void*) {
+}
+
+// Every report changes the state, so each one the pad sends becomes an input event
+static const uint16_t k_input_script[] = { 0x0001, 0x0002 };
+
+static bool startSession(int lights_min_interval_us) {
+    {
+        std::lock_guard<std::mutex> lock(g_received_mutex);
+        g_received.clear();
+    }
+    SDK::SimulatedPad pad;
+    pad.kind = SDK::SimulatedPad::Kind::SMX;
+    pad.player = 0;
+    pad.on_command = onCommand;
+    pad.script = k_input_script;
+    pad.script_length = 2;
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = &pad;
+    options.simulated_pad_count = 1;
+    options.lights_min_interval_us = lights_min_interval_us;
+    options.thread.scheduling = SDK::ThreadOptions::Scheduling::Normal;
+    if (!SDK::getInstance().initialize(noInput, nullptr, options)) {
+        fprintf(stderr, "couldn't start the simulated backend\n");
+        return false;
+    }
+    return SDK::getInstance().isPlayerConnected(SDK::Player::P1);
+}
+
+static bool submitFrame(int number) {
+    SDK::LightsFrame frame;
+    frame.command_count = 1;
+    frame.command_size[0] = 3;
+    frame.data[0] = k_frame_command;
+    frame.data[1] = static_cast<uint8_t>(number);
+    frame.data[2] = static_cast<uint8_t>(number >> 8);
+    return SDK::getInstance().submitLights(SDK::Player::P1, frame);
+}
+
+// Frames submitted every millisecond still reach the pad no more often than the minimum interval allows.
+// Arrival times are taken when the pad sees a frame, so a late arrival shortens the next gap; each gap gets
+// a generous margin for a loaded machine, and the whole run, which a late arrival can't shorten, a tight one.
+static void testMinimumInterval() {
+    const int interval_us = 50000;
+    const uint64_t gap_tolerance_ns = 20000000;
+    const uint64_t run_tolerance_ns = 5000000;
+    CHECK(startSession(interval_us));
+
+    int submitted = 0;
+    uint64_t end_ns = monotonicNanoseconds() + 600000000;
+    while (monotonicNanoseconds() < end_ns) {
+        CHECK(submitFrame(++submitted));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * interval_us / 1000));
+    SDK::getInstance().shutdown();
+
+    std::vector<ReceivedFrame> frames = received();
+    CHECK(frames.size() >= 6);
+    CHECK(frames.size() < static_cast<size_t>(submitted));
+    for (size_t i = 1; i < frames.size(); i++) {
+        CHECK(frames[i].arrival_ns - frames[i - 1].arrival_ns + gap_tolerance_ns >= interval_us * 1000ull);
+        CHECK(frames[i].number > frames[i - 1].number);
+    }
+    if (frames.size() >= 2) {
+        uint64_t run_ns = frames.back().arrival_ns - frames.front().arrival_ns;
+        CHECK(run_ns + run_tolerance_ns >= (frames.size() - 1) * interval_us * 1000ull);
+    }
+    // Whatever was newest when the submitting stopped still went out
+    CHECK(!frames.empty() && frames.back().number == submitted);
+}
+
+// While a frame waits out the interval, newer submissions replace it instead of queueing behind it
+static void testOnlyNewestFrameSent() {
+    const int interval_us = 100000;
+    CHECK(startSession(interval_us));
+
+    CHECK(submitFrame(1));
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    while (received().empty() && monotonicNanoseconds() < deadline_ns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int number = 2; number <= 50; number++) {
+        CHECK(submitFrame(number));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * interval_us / 1000));
+    SDK::getInstance().shutdown();
+
+    std::vector<ReceivedFrame> frames = received();
+    CHECK(frames.size() == 2);
+    if (frames.size() == 2) {
+        CHECK(frames[0].number == 1);
+        CHECK(frames[1].number == 50);
+    }
+}
+
+struct InputRun {
+    uint64_t events;
+    uint64_t median_interval_ns;
+    SDK::LatencyStats stats;
+};
+
+// Drains input for `run_ms` while submitting a lights frame every millisecond, or none at all. The pad's
+// command replies come in on the input endpoint too, so its own reports are counted as the events they make
+// rather than through LatencyStats::reports.
+static InputRun streamInput(bool with_lights, int run_ms) {
+    CHECK(startSession(1000));
+    std::vector<uint64_t> intervals;
+    uint64_t last_event_ns = 0;
+    SDK::InputEvent events[SDK::EVENT_QUEUE_CAPACITY];
+    int submitted = 0;
+    uint64_t end_ns = monotonicNanoseconds() + static_cast<uint64_t>(run_ms) * 1000000;
+    while (monotonicNanoseconds() < end_ns) {
+        if (with_lights) {
+            CHECK(submitFrame(++submitted));
+        }
+        size_t count = SDK::getInstance().drainEvents(SDK::Player::P1, events, SDK::EVENT_QUEUE_CAPACITY);
+        for (size_t i = 0; i < count; i++) {
+            if (last_event_ns != 0) {
+                intervals.push_back(events[i].timestamp_ns - last_event_ns);
+            }
+            last_event_ns = events[i].timestamp_ns;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    InputRun run;
+    run.stats = SDK::getInstance().getLatencyStats(SDK::Player::P1);
+    SDK::getInstance().shutdown();
+
+    run.events = intervals.size();
+    std::sort(intervals.begin(), intervals.end());
+    run.median_interval_ns = intervals.empty() ? 0 : intervals[intervals.size() / 2];
+    return run;
+}
+
+// Lights go out between input transfers, never in place of them: with a frame sent every millisecond the
+// pad's 1000 Hz reports arrive as often, and as evenly, as they do with no lights at all
+static void testInputUnaffected() {
+    const int run_ms = 500;
+    InputRun unlit = streamInput(false, run_ms);
+    InputRun lit = streamInput(true, run_ms);
+    CHECK(received().size() >= static_cast<size_t>(run_ms / 4));
+
+    CHECK(unlit.events >= static_cast<uint64_t>(run_ms / 2));
+    CHECK(lit.events * 10 >= unlit.events * 9);
+    CHECK(lit.median_interval_ns * 4 <= unlit.median_interval_ns * 5);
+    CHECK(lit.stats.dropped_events == 0);
+    CHECK(lit.stats.errors == 0);
+}
+
+int main() {
+    testMinimumInterval();
+    testOnlyNewestFrameSent();
+    testInputUnaffected();
+    if (g_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("lights: all checks passed\n");
+    return 0;
+}
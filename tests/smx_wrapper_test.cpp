@@ -0,0 +1,172 @@
+// Tests for the SMX API wrapper, built together with SMX.cpp and run against two simulated SMX pads that
+// each hold a fixed set of panels down: SMX_Start finds both, SMX_GetInfo and SMX_GetInputState report
+// them, SMX_SetConfig and SMX_FactoryReset reach the stage, and SMX_GetTestData decodes the simulated
+// sensor readings. Exits with status 1 if a check fails.
+
+#include "SMX.h"
+#include "lowlatencydancegamesdk.h"
+#include "MonotonicClock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+    #include "adapters/AdapterBase.h"
+}
+
+using SDK = LowLatencyDanceGameSDK;
+
+// Defined in SMX.cpp; what SMX_Start initializes the SDK with
+extern SDK::Options g_sdkOptions;
+
+static std::atomic<int> g_failures{0}; // onUpdate checks from the USB thread
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static const uint16_t k_p1_state = DancePadAdapterInputLeft | DancePadAdapterInputCenter;
+static const uint16_t k_p2_state = DancePadAdapterInputUp | DancePadAdapterInputRight;
+
+static std::atomic<int> g_updates[2];
+static std::atomic<int> g_resets[2];
+
+static void onUpdate(int pad, SMXUpdateCallbackReason reason, void* user) {
+    CHECK(user == &g_updates);
+    if (pad >= 0 && pad < 2 && reason == SMXUpdateCallback_Updated) {
+        g_updates[pad]++;
+    }
+    if (pad >= 0 && pad < 2 && reason == SMXUpdateCallback_FactoryResetCommandComplete) {
+        g_resets[pad]++;
+    }
+}
+
+// Polls until `pad` reports `state`, for up to a second
+static bool waitForState(int pad, uint16_t state) {
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    while (SMX_GetInputState(pad) != state) {
+        if (monotonicNanoseconds() >= deadline_ns) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Polls until SMX_GetConfig returns a config with `flags`, for up to a second
+static bool waitForConfigFlags(int pad, uint8_t flags) {
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    SMXConfig config;
+    while (!SMX_GetConfig(pad, &config) || config.flags != flags) {
+        if (monotonicNanoseconds() >= deadline_ns) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// A written config is read back from the stage, and a factory reset reports that it's done and clears it
+static void checkConfig(int pad) {
+    SMXConfig config;
+    config.flags = 1;
+    SMX_SetConfig(pad, &config);
+    CHECK(waitForConfigFlags(pad, 1));
+
+    SMX_FactoryReset(pad);
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    while (g_resets[pad] == 0 && monotonicNanoseconds() < deadline_ns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(g_resets[pad] == 1);
+    CHECK(waitForConfigFlags(pad, 0));
+}
+
+// Sensor test mode: every panel answers with its pressed or released level, its index as its DIP switches,
+// and the center panel with a bad jumper on its first sensor
+static void checkTestData(int pad, uint16_t state) {
+    SMX_SetTestMode(pad, SensorTestMode_CalibratedValues);
+
+    SMXSensorTestModeData data;
+    uint64_t deadline_ns = monotonicNanoseconds() + 1000000000;
+    bool received = false;
+    while (!(received = SMX_GetTestData(pad, &data)) && monotonicNanoseconds() < deadline_ns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(received);
+    if (received) {
+        for (int panel = 0; panel < 9; panel++) {
+            CHECK(data.bHaveDataFromPanel[panel]);
+            CHECK(data.iDIPSwitchPerPanel[panel] == panel);
+            int16_t level = (state & (1 << panel)) ? 800 : 10;
+            for (int sensor = 0; sensor < 4; sensor++) {
+                CHECK(data.sensorLevel[panel][sensor] == level + sensor);
+                CHECK(!data.bBadSensorInput[panel][sensor]);
+                CHECK(data.iBadJumper[panel][sensor] == (panel == 4 && sensor == 0));
+            }
+        }
+    }
+
+    SMX_SetTestMode(pad, SensorTestMode_Off);
+    CHECK(!SMX_GetTestData(pad, &data));
+}
+
+int main() {
+    // Plugged in the other way round, so the slots have to come from the pads' own player settings
+    SDK::SimulatedPad pads[2];
+    pads[0].player = 1;
+    pads[0].script = &k_p2_state;
+    pads[0].script_length = 1;
+    pads[1].player = 0;
+    pads[1].port_path[0] = 2;
+    pads[1].script = &k_p1_state;
+    pads[1].script_length = 1;
+
+    g_sdkOptions.backend = SDK::Backend::Simulated;
+    g_sdkOptions.simulated_pads = pads;
+    g_sdkOptions.simulated_pad_count = 2;
+    g_sdkOptions.thread.scheduling = SDK::ThreadOptions::Scheduling::Normal;
+
+    SMX_Start(onUpdate, &g_updates);
+
+    SMXInfo info;
+    for (int pad = 0; pad < 2; pad++) {
+        SMX_GetInfo(pad, &info);
+        CHECK(info.m_bConnected);
+        char serial[sizeof(info.m_Serial)];
+        snprintf(serial, sizeof(serial), "LLDGSDK-P%d", pad + 1);
+        CHECK(strcmp(info.m_Serial, serial) == 0);
+        CHECK(info.m_iFirmwareVersion == 0x0500);
+    }
+    SMX_GetInfo(2, &info);
+    CHECK(!info.m_bConnected);
+
+    CHECK(waitForState(0, k_p1_state));
+    CHECK(waitForState(1, k_p2_state));
+    CHECK(SMX_GetInputState(2) == 0);
+    CHECK(SMX_GetInputState(-1) == 0);
+    CHECK(g_updates[0] > 0);
+    CHECK(g_updates[1] > 0);
+
+    checkConfig(1);
+    checkTestData(0, k_p1_state);
+
+    SMX_Stop();
+    SMX_GetInfo(0, &info);
+    CHECK(!info.m_bConnected);
+    CHECK(SMX_GetInputState(0) == 0);
+
+    if (g_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures.load());
+        return 1;
+    }
+    printf("smx_wrapper: all checks passed\n");
+    return 0;
+}
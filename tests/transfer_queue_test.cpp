@@ -0,0 +1,74 @@
+// Tests for the input transfer queue, run against a simulated SMX pad that refuses one resubmission while
+// the rest of the queue is still in flight: the pad is dropped and picked up again, rather than left
+// connected with nothing left to complete. Exits with status 1 if a check fails.
+
+#include "lowlatencydancegamesdk.h"
+#include "MonotonicClock.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using SDK = LowLatencyDanceGameSDK;
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static void noInput(SDK::Player, uint16_t, void*) {
+}
+
+// Waits up to `timeout_ms` for P1 to have received more than `reports` reports in all
+static bool waitForReports(uint64_t reports, int timeout_ms) {
+    uint64_t deadline_ns = monotonicNanoseconds() + static_cast<uint64_t>(timeout_ms) * 1000000;
+    while (SDK::getInstance().getLatencyStats(SDK::Player::P1).reports <= reports) {
+        if (monotonicNanoseconds() >= deadline_ns) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static void testFailedResubmit() {
+    const int depth = 4;
+    const int failed_submit = 20; // Well past the initial fill, so other transfers are in flight
+
+    SDK::SimulatedPad pad;
+    pad.kind = SDK::SimulatedPad::Kind::SMX;
+    pad.player = 0;
+    pad.fail_input_submit = failed_submit;
+
+    SDK::Options options;
+    options.backend = SDK::Backend::Simulated;
+    options.simulated_pads = &pad;
+    options.simulated_pad_count = 1;
+    options.transfer_queue_depth = depth;
+    options.rescan_interval_ms = 50;
+    options.thread.scheduling = SDK::ThreadOptions::Scheduling::Normal;
+    CHECK(SDK::getInstance().initialize(noInput, nullptr, options));
+
+    // Reports keep coming well past the refused submission, so the pad was reattached rather than stalled
+    CHECK(waitForReports(static_cast<uint64_t>(failed_submit) * 10, 2000));
+    uint64_t reports = SDK::getInstance().getLatencyStats(SDK::Player::P1).reports;
+    CHECK(waitForReports(reports + 100, 1000));
+    CHECK(SDK::getInstance().isPlayerConnected(SDK::Player::P1));
+
+    SDK::getInstance().shutdown();
+}
+
+int main() {
+    testFailedResubmit();
+    if (g_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("transfer_queue: all checks passed\n");
+    return 0;
+}